@@ -0,0 +1,17 @@
+#pragma once
+
+namespace Renderer
+{
+	// Describes how often a buffer is written by the CPU so the renderer can place it in the best memory
+	enum BufferUsageHint
+	{
+		// Written once and read by the GPU many times, lives in device local memory
+		BUFFER_USAGE_STATIC,
+		// Written often and read by the GPU every frame, uses device local host visible memory where it exists
+		BUFFER_USAGE_DYNAMIC,
+		// Rewritten every frame and read by the GPU once, uses host memory
+		BUFFER_USAGE_STREAM,
+		// Written by the GPU and read back by the CPU, uses cached host memory
+		BUFFER_USAGE_READBACK
+	};
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace Renderer
+{
+	// Totals gathered while recording command buffers since the renderer started
+	struct CommandStats
+	{
+		// Pipeline, descriptor set, vertex buffer and index buffer binds that were recorded
+		unsigned long long binds = 0;
+		// Binds dropped because the command buffer already had that state bound
+		unsigned long long skipped_binds = 0;
+	};
+}
@@ -8,6 +8,7 @@ namespace Renderer
 	class IDescriptorSet
 	{
 	public:
+		virtual ~IDescriptorSet() {}
 		virtual void AttachBuffer(unsigned int location, IBuffer* buffer) = 0;
 		virtual std::vector<IBuffer*> GetBuffers() = 0;
 
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <renderer\IVertexBuffer.hpp>
+#include <renderer\IIndexBuffer.hpp>
+
+namespace Renderer
+{
+	class IUniformBuffer;
+	// Where a mesh lives inside a geometry arena, counted in vertices and indices rather than bytes
+	struct MeshRange
+	{
+		unsigned int first_vertex = 0;
+		unsigned int vertex_count = 0;
+		unsigned int first_index = 0;
+		// Zero for meshes that are drawn without an index buffer
+		unsigned int index_count = 0;
+	};
+
+	// One large vertex buffer and index buffer that many meshes are sub allocated from
+	// Model pools created from the same arena share their buffer bindings, so a pipeline can draw them together
+	// Per instance buffers are attached to the arena rather than the pools, each pool is handed its own range of instances in them
+	class IGeometryArena
+	{
+	public:
+		virtual ~IGeometryArena() {}
+		// Copy a mesh into the arena, indices are 16 bit and relative to the first vertex of the mesh
+		// An empty range, with a vertex_count of zero, is returned when the arena has no room for it
+		virtual MeshRange AddMesh(void* vertices, unsigned int vertex_count, unsigned short* indices = nullptr, unsigned int index_count = 0) = 0;
+		// Hand the space back once every frame that could still draw the mesh has finished
+		virtual void RemoveMesh(MeshRange mesh) = 0;
+		virtual IVertexBuffer* GetVertexBuffer() = 0;
+		virtual IIndexBuffer* GetIndexBuffer() = 0;
+		// Bind a per instance buffer for every pool drawing from the arena, it needs room for the instance capacity of the arena
+		// Pools that already have models need UpdateModelBuffer called to point them at it
+		virtual void AttachBuffer(unsigned int index, IUniformBuffer* buffer) = 0;
+	};
+}
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <map>
+#include <cstring>
+#include <assert.h>
 
 namespace Renderer
 {
@@ -8,6 +9,9 @@ namespace Renderer
 	class IModel
 	{
 	public:
+		// Buffer indices a model pool can attach, data is looked up straight from a table of this size
+		// so every call that takes a buffer index checks it against this
+		static const unsigned int MAX_MODEL_BUFFERS = 8;
 		IModel(unsigned int model_pool_index);
 		void SetDataPointer(unsigned int index, void* data);
 		void SetData(unsigned int index, void* data, unsigned int size);
@@ -22,16 +26,19 @@ namespace Renderer
 		void Remove();
 	protected:
 		unsigned int m_model_pool_index;
-		std::map<unsigned int, void*> m_data_pointers;
+		// Where this model's element sits in each attached buffer, indexed by buffer index, null for buffers that are not attached
+		void* m_data_pointers[MAX_MODEL_BUFFERS];
 	};
 	template<class T>
 	inline void IModel::SetData(unsigned int index, T data)
 	{
+		assert(index < MAX_MODEL_BUFFERS && m_data_pointers[index] && "No buffer attached at this model buffer index");
 		memcpy(m_data_pointers[index], &data, sizeof(T));
 	}
 	template<class T>
 	inline T& IModel::GetData(unsigned int index)
 	{
+		assert(index < MAX_MODEL_BUFFERS && m_data_pointers[index] && "No buffer attached at this model buffer index");
 		return *static_cast<T*>(m_data_pointers[index]);
 	}
 }
\ No newline at end of file
@@ -16,15 +16,30 @@ namespace Renderer
 		IModelPool(IVertexBuffer* vertex_buffer, IIndexBuffer* index_buffer);
 		virtual ~IModelPool() {};
 		bool Indexed();
+		// Null when the pool can not hold another model, such as when its geometry arena is out of instance space
 		virtual IModel * CreateModel() = 0;
 		virtual IModel* GetModel(int index) = 0;
 		virtual void RemoveModel(IModel* model) = 0;
+		// Bulk versions of the calls above and of IModel::ShouldRender, the buffers are written once for the whole call rather than once per model
+		// models has to have room for count models, the number created is returned and the entries past it are set to null
+		virtual unsigned int CreateModels(unsigned int count, IModel** models) = 0;
+		virtual void RemoveModels(IModel** models, unsigned int count) = 0;
+		// Show or hide the models at the given pool indices
+		virtual void SetVisibility(const unsigned int* indices, const bool* visible, unsigned int count) = 0;
+		// Show every model whose pool index is set in the mask and hide the rest, models past the end of the mask are hidden
+		virtual void SetVisibilityMask(const std::vector<bool>& mask) = 0;
 		virtual void Update() = 0;
 		virtual void AttachBuffer(unsigned int index, IUniformBuffer * buffer) = 0;
 		virtual void UpdateModelBuffer(unsigned int index) = 0;
 		virtual void AttachDescriptorSet(unsigned int index, IDescriptorSet* descriptor_set) = 0;
 		virtual std::vector<IDescriptorSet*> GetDescriptorSets() = 0;
 		virtual void SetVertexDrawCount(unsigned int count) = 0;
+		// Draw every visible model as an instance of one indirect command instead of one command per model, so hidden models cost nothing
+		// The indices of the visible models are packed into a buffer of unsigned ints bound as a per instance vertex buffer after the attached buffers,
+		// the shader reads its instance index from there and looks its data up itself rather than through per instance attributes
+		// The attached buffers are not bound as vertex buffers while remapping, so they have to be read through a descriptor set
+		// For pools drawing from a geometry arena the index is into the arena buffers, so it is offset by the start of the pools instance range
+		virtual void SetInstanceRemap(bool remap) = 0;
 		void SetVertexBuffer(IVertexBuffer* vertex_buffer);
 		IVertexBuffer * GetVertexBuffer();
 		IIndexBuffer * GetIndexBuffer();
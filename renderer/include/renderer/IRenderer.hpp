@@ -3,6 +3,7 @@
 #include <vector>
 #include <renderer/APIs.hpp>
 #include <renderer/NativeWindowHandle.hpp>
+#include <renderer/SwapchainConfiguration.hpp>
 #include <renderer\DescriptorType.hpp>
 #include <renderer\ShaderStage.hpp>
 #include <renderer\IUniformBuffer.hpp>
@@ -13,26 +14,41 @@
 #include <renderer\IComputeProgram.hpp>
 #include <renderer\IModel.hpp>
 #include <renderer\IModelPool.hpp>
+#include <renderer\IGeometryArena.hpp>
 #include <renderer\VertexBase.hpp>
 #include <renderer\ITextureBuffer.hpp>
 #include <renderer\IDescriptor.hpp>
 #include <renderer\IDescriptorPool.hpp>
+#include <renderer\BufferUsageHint.hpp>
+#include <renderer\UploadHandle.hpp>
+#include <renderer\MemoryStats.hpp>
+#include <renderer\CommandStats.hpp>
 
 namespace Renderer
 {
 	class IRenderer
 	{
 	public:
+		// Idle interval that never forces a frame, Update only draws when something changed
+		static const unsigned int NO_IDLE_LIMIT = 0xFFFFFFFF;
 		IRenderer();
 		// Starts the renderer, this class is inherited by the parent class and it will define the function body
-		virtual bool Start(NativeWindowHandle* window_handle) = 0;
+		// The configuration picks the present mode, swapchain image count and how far the CPU may run ahead of the GPU
+		virtual bool Start(NativeWindowHandle* window_handle, SwapchainConfiguration configuration = SwapchainConfiguration()) = 0;
 
 		// Update the renderer, this class is inherited by the parent class and it will define the function body
 		virtual void Update() = 0;
 		// Stop the renderer, this class is inherited by the parent class and it will define the function body
 		virtual void Stop() = 0;
 		// Rebuild the rendering platform when a event takes place that it is required, such as a screen resize
+		// Requests are coalesced and the rebuild happens at the start of the next frame
 		virtual void Rebuild() = 0;
+		// By default, or with 0, a frame is drawn on every Update
+		// Otherwise Update only draws a frame when a buffer, model, pipeline or the swapchain changed since the last one,
+		// and after this many milliseconds without a change a frame is drawn anyway, NO_IDLE_LIMIT waits for a change however long it takes
+		virtual void SetMaxIdleInterval(unsigned int milliseconds) = 0;
+		// Draw on the next Update even if nothing the renderer can see has changed
+		virtual void RequestRedraw() = 0;
 
 		// Creates a instance of the renderer based on the chosen API. this IRenderer can be cast into the parent class
 		static IRenderer* CreateRenderer(const RenderingAPI api);
@@ -44,11 +60,11 @@ namespace Renderer
 		// Remove the renderer from the list of renderers to be updated when calling UpdateAll, the renderer will still work as a stand alone renderer
 		static void UnregisterRenderer(IRenderer* renderer);
 
-		virtual IUniformBuffer* CreateUniformBuffer(void* dataPtr, BufferChain level, unsigned int indexSize, unsigned int elementCount, bool modifiable = false) = 0;
+		virtual IUniformBuffer* CreateUniformBuffer(void* dataPtr, BufferChain level, unsigned int indexSize, unsigned int elementCount, bool modifiable = false, BufferUsageHint usage = BUFFER_USAGE_DYNAMIC) = 0;
 
-		virtual IVertexBuffer* CreateVertexBuffer(void* dataPtr, unsigned int indexSize, unsigned int elementCount) = 0;
+		virtual IVertexBuffer* CreateVertexBuffer(void* dataPtr, unsigned int indexSize, unsigned int elementCount, BufferUsageHint usage = BUFFER_USAGE_STATIC) = 0;
 
-		virtual IIndexBuffer* CreateIndexBuffer(void* dataPtr, unsigned int indexSize, unsigned int elementCount) = 0;
+		virtual IIndexBuffer* CreateIndexBuffer(void* dataPtr, unsigned int indexSize, unsigned int elementCount, BufferUsageHint usage = BUFFER_USAGE_STATIC) = 0;
 
 		virtual IGraphicsPipeline* CreateGraphicsPipeline(std::map<ShaderStage, const char*> paths, bool priority = false) = 0;
 
@@ -62,12 +78,38 @@ namespace Renderer
 
 		virtual IModelPool* CreateModelPool(IVertexBuffer* vertex_buffer) = 0;
 
+		// Create one device local vertex and index buffer that meshes are sub allocated from
+		// instance_capacity is the number of instances the pools drawing from the arena can have between them
+		virtual IGeometryArena* CreateGeometryArena(unsigned int vertex_size, unsigned int vertex_capacity, unsigned int index_capacity, unsigned int instance_capacity) = 0;
+
+		// Draw a mesh from a geometry arena, pools from the same arena attached to a pipeline are drawn together when they share their bindings
+		virtual IModelPool* CreateModelPool(IGeometryArena* geometry_arena, MeshRange mesh) = 0;
+
 		virtual ITextureBuffer* CreateTextureBuffer(void* dataPtr, DataFormat format, unsigned int width, unsigned int height) = 0;
 
 		virtual IDescriptor* CreateDescriptor(DescriptorType descriptor_type, ShaderStage shader_stage, unsigned int binding) = 0;
 
 		virtual IDescriptorPool* CreateDescriptorPool(std::vector<IDescriptor*> descriptors) = 0;
 
+		// Send every upload recorded since the last call to the GPU, this also happens at the start of each Update
+		virtual UploadHandle SubmitUploads() = 0;
+
+		virtual bool IsUploadComplete(UploadHandle handle) = 0;
+
+		virtual void WaitForUpload(UploadHandle handle) = 0;
+
+		// Report GPU memory use per heap, memory type and resource category, along with the driver budget when it is available
+		virtual MemoryStats GetMemoryStats() = 0;
+
+		// Report the host memory the driver allocated through the renderer, per allocation scope
+		virtual HostMemoryStats GetHostMemoryStats() = 0;
+
+		// How many binds have been recorded, and how many were dropped because they were already bound
+		virtual CommandStats GetCommandStats() = 0;
+
+		// Scale of the window the scene is rendered at, only below 1 when dynamic resolution is enabled in the swapchain configuration
+		virtual float GetResolutionScale() = 0;
+
 		bool IsRunning();
 	private:
 		// Store all renderers generated by the CreateRenderer class
@@ -3,6 +3,8 @@
 #include <renderer\IBuffer.hpp>
 #include <renderer\ShaderStage.hpp>
 
+#include <functional>
+
 namespace Renderer
 {
 
@@ -13,5 +15,9 @@ namespace Renderer
 		virtual void GetData(BufferSlot slot) = 0;
 		virtual void GetData(BufferSlot slot, unsigned int count) = 0;
 		virtual void GetData(BufferSlot slot, unsigned int startIndex, unsigned int count) = 0;
+		// Called right before each frame is submitted with the local data of the latched slot, whatever it leaves there is what that frame reads
+		// Suited to data such as a camera that should be as fresh as possible, the frames already queued keep their own copy
+		virtual void SetLateLatch(BufferSlot slot, std::function<void(void* data)> callback) = 0;
+		virtual void ClearLateLatch() = 0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+namespace Renderer
+{
+	// What a piece of GPU memory is being used for
+	enum MemoryCategory
+	{
+		MEMORY_CATEGORY_VERTEX,
+		MEMORY_CATEGORY_INDEX,
+		MEMORY_CATEGORY_UNIFORM,
+		MEMORY_CATEGORY_TEXTURE,
+		MEMORY_CATEGORY_STAGING,
+		MEMORY_CATEGORY_INDIRECT,
+		// Depth images, storage buffers and anything else that does not fit above
+		MEMORY_CATEGORY_OTHER,
+		MEMORY_CATEGORY_COUNT
+	};
+
+	struct MemoryHeapStats
+	{
+		// Size of the heap as reported by the driver
+		unsigned long long size = 0;
+		// Bytes the renderer has allocated from the driver, and how much of that is handed out to resources
+		unsigned long long allocated = 0;
+		unsigned long long used = 0;
+		// Budget and usage for the whole process from VK_EXT_memory_budget, both are zero when it is not available
+		unsigned long long budget = 0;
+		unsigned long long usage = 0;
+		bool device_local = false;
+	};
+
+	struct MemoryTypeStats
+	{
+		unsigned int heap_index = 0;
+		bool device_local = false;
+		bool host_visible = false;
+		bool host_coherent = false;
+		bool host_cached = false;
+		unsigned long long allocated = 0;
+		unsigned long long used = 0;
+		// Separate driver allocations and the resources placed in them
+		unsigned int block_count = 0;
+		unsigned int allocation_count = 0;
+	};
+
+	struct MemoryCategoryStats
+	{
+		unsigned int allocation_count = 0;
+		unsigned long long used = 0;
+	};
+
+	struct MemoryStats
+	{
+		// True when the heap budgets came from the driver
+		bool has_budget = false;
+		std::vector<MemoryHeapStats> heaps;
+		std::vector<MemoryTypeStats> types;
+		MemoryCategoryStats categories[MEMORY_CATEGORY_COUNT];
+	};
+
+	// Lifetime of a host allocation made by the driver, in the same order as VkSystemAllocationScope
+	enum HostAllocationScope
+	{
+		HOST_SCOPE_COMMAND,
+		HOST_SCOPE_OBJECT,
+		HOST_SCOPE_CACHE,
+		HOST_SCOPE_DEVICE,
+		HOST_SCOPE_INSTANCE,
+		HOST_SCOPE_COUNT
+	};
+
+	struct HostScopeStats
+	{
+		// Number of calls the driver made into the allocator
+		unsigned long long allocation_count = 0;
+		unsigned long long reallocation_count = 0;
+		unsigned long long free_count = 0;
+		// Allocations that were served from an arena instead of the heap
+		unsigned long long arena_allocation_count = 0;
+		// Bytes currently held, the most ever held at once and the total handed out
+		unsigned long long bytes = 0;
+		unsigned long long peak_bytes = 0;
+		unsigned long long total_bytes = 0;
+		// Memory the driver allocated itself and reported to us, such as executable code
+		unsigned long long internal_bytes = 0;
+	};
+
+	struct HostMemoryStats
+	{
+		HostScopeStats scopes[HOST_SCOPE_COUNT];
+	};
+}
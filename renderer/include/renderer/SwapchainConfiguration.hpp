@@ -0,0 +1,37 @@
+#pragma once
+
+namespace Renderer
+{
+	// How finished frames are handed to the display
+	enum PresentMode
+	{
+		// Shown straight away without waiting for vertical blank, uncapped but may tear
+		PRESENT_MODE_IMMEDIATE,
+		// Waits for vertical blank, a newer frame replaces the queued one so rendering is not capped
+		PRESENT_MODE_MAILBOX,
+		// Waits for vertical blank, frames queue up and rendering is locked to the refresh rate
+		PRESENT_MODE_FIFO,
+		// As FIFO, but a late frame is shown straight away instead of waiting for the next blank
+		PRESENT_MODE_FIFO_RELAXED
+	};
+
+	struct SwapchainConfiguration
+	{
+		// Falls back to the nearest mode the surface supports, FIFO is always available
+		PresentMode present_mode = PRESENT_MODE_MAILBOX;
+		// Swapchain images to ask for, 0 picks one more than the surface minimum
+		unsigned int image_count = 0;
+		// How many frames the CPU may queue ahead of the GPU, lower values cut input latency
+		// Clamped to 1 to 3
+		unsigned int max_frame_latency = 2;
+		// Render the scene into an offscreen target at a scale picked from the measured GPU frame time, then filter it up to the window
+		// Ignored when the device can not time frames or blit to the swapchain images
+		bool dynamic_resolution = false;
+		// GPU time per frame, in milliseconds, the scale is adjusted to hold
+		float target_frame_time = 16.0f;
+		// Bounds of the scale applied to both sides of the window
+		// The maximum is clamped to 0.05 to 1 and the minimum to 0.05 to the maximum
+		float min_resolution_scale = 0.5f;
+		float max_resolution_scale = 1.0f;
+	};
+}
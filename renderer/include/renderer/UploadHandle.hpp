@@ -0,0 +1,7 @@
+#pragma once
+
+namespace Renderer
+{
+	// Identifies a batch of uploads that has been handed to the GPU, handles increase in submission order
+	typedef unsigned long long UploadHandle;
+}
\ No newline at end of file
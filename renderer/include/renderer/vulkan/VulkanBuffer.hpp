@@ -4,6 +4,9 @@
 #include <renderer/vulkan/VulkanDevice.hpp>
 #include <renderer/vulkan/VulkanBufferData.hpp>
 #include <renderer\IBuffer.hpp>
+#include <renderer\BufferUsageHint.hpp>
+
+#include <vector>
 
 namespace Renderer
 {
@@ -13,7 +16,7 @@ namespace Renderer
 		class VulkanBuffer : public virtual IBuffer
 		{
 		public:
-			VulkanBuffer(VulkanDevice* device, BufferChain level, void* dataPtr, unsigned int indexSize, unsigned int elementCount, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _memory_propertys_flag);
+			VulkanBuffer(VulkanDevice* device, BufferChain level, void* dataPtr, unsigned int indexSize, unsigned int elementCount, VkBufferUsageFlags _usage, VkMemoryPropertyFlags _memory_propertys_flag, VkMemoryPropertyFlags _preferred_propertys_flag = 0);
 			~VulkanBuffer();
 
 			virtual void SetData(BufferSlot slot);
@@ -27,19 +30,38 @@ namespace Renderer
 			VulkanBufferData* GetBufferData(BufferSlot slot);
 			VkDescriptorImageInfo& GetDescriptorImageInfo(BufferSlot slot);
 			VkDescriptorBufferInfo& GetDescriptorBufferInfo(BufferSlot slot);
+			// Merge the dirty ranges of every slot into atom aligned flush ranges and clear them
+			void CollectFlushRanges(std::vector<VkMappedMemoryRange>& ranges, VkDeviceSize atom_size);
 
 		protected:
 			void CreateBuffer(BufferSlot slot);
 			void DestroyBuffer(BufferSlot slot);
-			void Flush(BufferSlot slot);
+			// Record a written byte range, it will be flushed with everything else at the next frame boundary
+			void MarkDirty(BufferSlot slot, VkDeviceSize offset, VkDeviceSize size);
+			void Invalidate(BufferSlot slot);
+			// Upload count elements starting at startIndex through the devices staging ring
+			void StageData(BufferSlot slot, unsigned int startIndex, unsigned int count);
 			VulkanDevice * m_device;
 			VkBufferUsageFlags m_usage;
 			VkMemoryPropertyFlags m_memory_propertys_flag;
+			VkMemoryPropertyFlags m_preferred_propertys_flag;
+
+			// Memory properties a buffer must have and would like to have for a usage hint
+			static VkMemoryPropertyFlags RequiredMemoryPropertys(BufferUsageHint usage);
+			static VkMemoryPropertyFlags PreferredMemoryPropertys(BufferUsageHint usage);
 
+			struct DirtyRange
+			{
+				VkDeviceSize offset;
+				VkDeviceSize size;
+			};
 			struct GpuBufferAllocation
 			{
 				bool mapped = false;
+				// Set once the graphics queue family owns the buffer, uploads on a transfer queue have to take it back first
+				bool graphics_owned = false;
 				VulkanBufferData buffer;
+				std::vector<DirtyRange> dirty_ranges;
 				union
 				{
 					VkDescriptorImageInfo image_info;
@@ -47,6 +69,10 @@ namespace Renderer
 				};
 			};
 			GpuBufferAllocation* m_gpu_allocation = nullptr;
+			// Set while the device holds this buffer in its list of buffers to flush
+			bool m_flush_registered = false;
+			// Past this many separate ranges a slot is flushed as one range
+			static const unsigned int m_max_flush_ranges = 8;
 
 		};
 	}
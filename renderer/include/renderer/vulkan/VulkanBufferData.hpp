@@ -1,6 +1,6 @@
 #pragma once
 
-#include <renderer\vulkan\VulkanBufferData.hpp>
+#include <renderer\vulkan\VulkanMemoryAllocator.hpp>
 
 namespace Renderer
 {
@@ -11,7 +11,7 @@ namespace Renderer
 			VkBuffer buffer = VK_NULL_HANDLE;
 			VkDeviceSize size = VK_NULL_HANDLE;
 			VkDeviceSize alignment = VK_NULL_HANDLE;
-			VkDeviceMemory buffer_memory = VK_NULL_HANDLE;
+			VulkanAllocation allocation;
 			void* mapped_memory = nullptr;
 		};
 	}
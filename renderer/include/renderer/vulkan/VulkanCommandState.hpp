@@ -0,0 +1,51 @@
+#pragma once
+
+#include <renderer/vulkan/VulkanHeader.hpp>
+
+#include <vector>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		// Remembers what is bound in one command buffer while it is recorded, so binds that would not change anything are dropped
+		// Only valid for a single recording, dynamic state and anything bound outside of it is not tracked
+		class VulkanCommandState
+		{
+		public:
+			VulkanCommandState(VkCommandBuffer command_buffer);
+			VkCommandBuffer& GetCommandBuffer();
+			void BindPipeline(VkPipelineBindPoint bind_point, VkPipeline pipeline);
+			void BindDescriptorSet(VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t set, VkDescriptorSet descriptor_set);
+			void BindVertexBuffers(uint32_t first_binding, uint32_t count, const VkBuffer* buffers, const VkDeviceSize* offsets);
+			void BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType index_type);
+			// Binds that reached the command buffer, and binds dropped because the state was already bound
+			unsigned int GetBindCount();
+			unsigned int GetSkippedBindCount();
+		private:
+			struct BoundDescriptorSet
+			{
+				VkPipelineBindPoint bind_point = VK_PIPELINE_BIND_POINT_MAX_ENUM;
+				VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+			};
+			struct BoundVertexBuffer
+			{
+				VkBuffer buffer = VK_NULL_HANDLE;
+				VkDeviceSize offset = 0;
+			};
+
+			VkCommandBuffer m_command_buffer;
+			VkPipeline m_graphics_pipeline = VK_NULL_HANDLE;
+			VkPipeline m_compute_pipeline = VK_NULL_HANDLE;
+			// Sets bound with a different layout may be disturbed, so the tracked sets are only trusted while the layout stays the same
+			VkPipelineLayout m_layout = VK_NULL_HANDLE;
+			std::vector<BoundDescriptorSet> m_descriptor_sets;
+			std::vector<BoundVertexBuffer> m_vertex_buffers;
+			VkBuffer m_index_buffer = VK_NULL_HANDLE;
+			VkDeviceSize m_index_offset = 0;
+			VkIndexType m_index_type = VK_INDEX_TYPE_MAX_ENUM;
+			unsigned int m_bind_count = 0;
+			unsigned int m_skipped_bind_count = 0;
+		};
+	}
+}
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <renderer/vulkan/VulkanHeader.hpp>
+#include <renderer/MemoryStats.hpp>
+#include <renderer/UploadHandle.hpp>
 
 #include <assert.h>
 #include <vector>
@@ -12,6 +14,7 @@ namespace Renderer
 		class VulkanDevice;
 		class VulkanPhysicalDevice;
 		struct VulkanBufferData;
+		struct VulkanAllocation;
 		namespace VulkanCommon
 		{
 
@@ -21,9 +24,12 @@ namespace Renderer
 
 			VkFormat FindSupportedFormat(VulkanDevice* device, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
-			void CreateImage(VulkanDevice* device, VkExtent2D extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VkDeviceMemory & image_memory);
+			// Returns false and leaves image null when no memory could be allocated for it
+			bool CreateImage(VulkanDevice* device, VkExtent2D extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VulkanAllocation & image_memory);
 
-			uint32_t FindMemoryType(VulkanPhysicalDevice* device, uint32_t type_filter, VkMemoryPropertyFlags properties);
+			// Find a memory type that has all of the required properties, picking the one that has the most of the preferred properties
+			// Returns UINT32_MAX when no type has them
+			uint32_t FindMemoryType(VulkanPhysicalDevice* device, uint32_t type_filter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred = 0);
 
 			void TransitionImageLayout(VulkanDevice* device, VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
 
@@ -35,7 +41,13 @@ namespace Renderer
 
 			bool HasStencilComponent(VkFormat format);
 
-			void CreateBuffer(VulkanDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VulkanBufferData & buffer);
+			// Work out what a resource is used for from its usage flags so its memory can be reported under the right category
+			MemoryCategory GetBufferMemoryCategory(VkBufferUsageFlags usage);
+
+			MemoryCategory GetImageMemoryCategory(VkImageUsageFlags usage);
+
+			// Returns false and leaves the buffer null when no memory could be allocated for it
+			bool CreateBuffer(VulkanDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VulkanBufferData & buffer, VkMemoryPropertyFlags preferred = 0);
 
 			void MapBufferMemory(VulkanDevice* device, VulkanBufferData& buffer, VkDeviceSize size);
 
@@ -47,7 +59,8 @@ namespace Renderer
 
 			VkShaderModule CreateShaderModule(VulkanDevice * device, const std::vector<char>& code);
 
-			void CopyBuffer(VulkanDevice * device, VkBuffer from_buffer, VkBuffer to_buffer, VkDeviceSize size);
+			// Records the copy into the device's pending upload batch and submits it without waiting
+			UploadHandle CopyBuffer(VulkanDevice * device, VkBuffer from_buffer, VkBuffer to_buffer, VkDeviceSize size);
 
 			// Sorced from https://github.com/SaschaWillems/Vulkan/blob/master/base/VulkanTools.cpp
 			void SetImageLayout(VkCommandBuffer cmdbuffer, VkImage image, VkImageLayout oldImageLayout, VkImageLayout newImageLayout, VkImageSubresourceRange subresourceRange);
@@ -17,7 +17,6 @@ namespace Renderer
 			virtual void Run();
 		private:
 			VulkanDevice * m_device;
-			VkFence m_fence;
 			VkCommandBuffer m_command_buffer;
 		};
 	}
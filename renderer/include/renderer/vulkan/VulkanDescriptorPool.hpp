@@ -12,6 +12,7 @@ namespace Renderer
 	namespace Vulkan
 	{
 		class VulkanDevice;
+		class VulkanDescriptorSet;
 		class VulkanDescriptorPool : public IDescriptorPool, public VulkanStatus
 		{
 		public:
@@ -21,6 +22,8 @@ namespace Renderer
 			VkDescriptorSetLayout GetDescriptorSetLayout();
 			std::vector<IDescriptor*> GetDescriptors();
 			virtual IDescriptorSet * CreateDescriptorSet();
+			// Hand the set back to the pool once no frame in flight is using it
+			void FreeDescriptorSet(VulkanDescriptorSet* descriptor_set);
 		private:
 			VulkanDevice * m_device;
 			std::vector<VkDescriptorSetLayoutBinding> m_layout_bindings;
@@ -29,6 +32,8 @@ namespace Renderer
 			std::vector<IDescriptor*> m_descriptor;
 			VkDescriptorPool m_descriptor_pool;
 			VkDescriptorSetLayout m_descriptor_set_layout;
+			// Sets that are still alive and need detaching if the pool goes first
+			std::vector<VulkanDescriptorSet*> m_descriptor_sets;
 		};
 
 	}
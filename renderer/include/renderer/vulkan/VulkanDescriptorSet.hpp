@@ -17,11 +17,14 @@ namespace Renderer
 		{
 		public:
 			VulkanDescriptorSet(VulkanDevice* device, VulkanDescriptorPool * descriptor_pool, VkDescriptorSet set);
+			virtual ~VulkanDescriptorSet();
 			VkDescriptorSet& GetDescriptorSet();
 			virtual void UpdateSet();
 			virtual void AttachBuffer(unsigned int location, IBuffer* buffer);
 			virtual std::vector<IBuffer*> GetBuffers();
 			bool HasBufferAtLocation(unsigned int location);
+			// Called when the pool is destroyed first, the set is freed along with the pool
+			void DetachPool();
 		private:
 			VulkanDescriptorPool * m_descriptor_pool;
 			VulkanDevice* m_device;
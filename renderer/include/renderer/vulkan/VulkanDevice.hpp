@@ -4,6 +4,15 @@
 
 #include <renderer/vulkan/VulkanInitializers.hpp>
 #include <renderer/vulkan/VulkanStatus.hpp>
+#include <renderer/vulkan/VulkanTimeline.hpp>
+#include <renderer/UploadHandle.hpp>
+#include <renderer/MemoryStats.hpp>
+#include <renderer/CommandStats.hpp>
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <atomic>
 
 namespace Renderer
 {
@@ -11,6 +20,11 @@ namespace Renderer
 	{
 		class VulkanInstance;
 		class VulkanPhysicalDevice;
+		class VulkanMemoryAllocator;
+		class VulkanStagingRing;
+		class VulkanBuffer;
+		class VulkanUniformBuffer;
+		class VulkanUploadBatch;
 		class VulkanDevice : public VulkanStatus
 		{
 		public:
@@ -18,15 +32,74 @@ namespace Renderer
 			~VulkanDevice();
 			VkDevice* GetVulkanDevice();
 			VulkanPhysicalDevice * GetVulkanPhysicalDevice();
+			// Host allocation callbacks owned by the instance, passed to every create and destroy call
+			const VkAllocationCallbacks* GetAllocationCallbacks();
 			VkQueue* GetGraphicsQueue();
 			VkQueue* GetPresentQueue();
 			VkQueue* GetComputeQueue();
+			VkQueue* GetTransferQueue();
+			// True when uploads run on their own queue family and need ownership transfers
+			bool HasDedicatedTransferQueue();
+			// Every submit goes through the timeline of its queue, queues that share a VkQueue share a timeline
+			VulkanTimeline* GetGraphicsTimeline();
+			VulkanTimeline* GetComputeTimeline();
+			VulkanTimeline* GetTransferTimeline();
 			VkCommandPool* GetGraphicsCommandPool();
 			VkCommandPool* GetComputeCommandPool();
+			VkCommandPool* GetTransferCommandPool();
+			VulkanMemoryAllocator* GetMemoryAllocator();
+			VulkanStagingRing* GetStagingRing();
+			// Allocator totals along with the driver reported heap budgets when VK_EXT_memory_budget is enabled
+			void GetMemoryStats(MemoryStats& stats);
+			// Buffers with host writes that need flushing before the GPU reads them
+			void RegisterDirtyBuffer(VulkanBuffer* buffer);
+			void UnregisterBuffer(VulkanBuffer* buffer);
+			// Flush every pending host write with a single vkFlushMappedMemoryRanges call
+			void FlushMappedRanges();
+			// Add the binds recorded and skipped by a command state, safe to call from recording threads
+			void AddCommandStats(unsigned int binds, unsigned int skipped_binds);
+			void GetCommandStats(CommandStats& stats);
+			// True when up to max_draw_count indirect draws can be issued in one call that reads the real count from a buffer, needs VK_KHR_draw_indirect_count
+			bool CanDrawIndirectCount(uint32_t max_draw_count);
+			// Draw the commands at the start of buffer, how many is read from the first uint32_t of count_buffer when the command executes
+			void CmdDrawIndirectCount(VkCommandBuffer command_buffer, bool indexed, VkBuffer buffer, VkBuffer count_buffer, uint32_t max_draw_count, uint32_t stride);
+			// Note that something the next frame draws has changed, frames are only drawn while there are changes
+			void MarkSceneChanged();
+			// Returns whether the scene changed since the last call and clears the flag
+			bool CheckSceneChanged();
+			// Uniform buffers whose latched slot is refreshed right before every frame is submitted
+			void RegisterLateLatch(VulkanUniformBuffer* buffer);
+			void UnregisterLateLatch(VulkanUniformBuffer* buffer);
+			const std::vector<VulkanUniformBuffer*>& GetLateLatches();
+			// Batch that buffer and texture uploads are recorded into until the next SubmitUploads
+			VulkanUploadBatch* GetUploadBatch();
+			// Submit the pending upload batch, if there was nothing to upload the handle of the last submitted batch is returned
+			UploadHandle SubmitUploads();
+			// Handle the pending batch will be given when it is submitted, or the last submitted handle if it has nothing in it
+			UploadHandle GetPendingUploadHandle();
+			bool IsUploadComplete(UploadHandle handle);
+			void WaitForUpload(UploadHandle handle);
+			// Release the oldest submitted batch, waiting for it if asked to, returns false if there are none left
+			bool RetireUpload(bool wait);
+			// Point reached once every upload submitted so far has finished, empty if none are in flight
+			VulkanTimelinePoint GetUploadPoint();
+			// Submit a frame on the graphics timeline, frames are numbered in the order they are submitted
+			uint64_t SubmitFrame(const VulkanSubmission& submission);
+			// Serial of the last submitted frame
+			uint64_t GetFrameSerial();
+			// Block until the frame with this serial has finished on the GPU, then retire everything that completed with it
+			void WaitForFrame(uint64_t serial);
+			// Note which frames have finished and run any destruction that is now safe, wait blocks until every frame in flight is done
+			void RetireFrames(bool wait = false);
+			// Run destroy once every frame submitted so far and the pending upload batch have finished, right away if nothing is in flight
+			// Buffers and textures release their Vulkan objects through this, so they can be deleted while frames in flight still use them
+			void DeferDestroy(std::function<void()> destroy);
 			void GetGraphicsCommand(VkCommandBuffer* buffers, uint32_t count);
 			void GetGraphicsCommand(VkCommandBuffer* buffers, bool begin = false);
 			void SubmitGraphicsCommand(VkCommandBuffer* buffers, uint32_t count);
 			void FreeGraphicsCommand(VkCommandBuffer* buffers, uint32_t count);
+			void GetTransferCommand(VkCommandBuffer* buffers, uint32_t count);
+			void FreeTransferCommand(VkCommandBuffer* buffers, uint32_t count);
 		private:
 			VulkanInstance * m_instance;
 			VulkanPhysicalDevice * m_physical_device;
@@ -34,8 +107,51 @@ namespace Renderer
 			VkQueue m_graphics_queue;
 			VkQueue m_present_queue;
 			VkQueue m_compute_queue;
+			VkQueue m_transfer_queue;
 			VkCommandPool m_graphics_command_pool;
 			VkCommandPool m_compute_command_pool;
+			VkCommandPool m_transfer_command_pool = VK_NULL_HANDLE;
+			VulkanTimeline* m_graphics_timeline = nullptr;
+			VulkanTimeline* m_compute_timeline = nullptr;
+			VulkanTimeline* m_transfer_timeline = nullptr;
+			VulkanMemoryAllocator* m_memory_allocator = nullptr;
+			VulkanStagingRing* m_staging_ring = nullptr;
+			PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_get_memory_properties2 = nullptr;
+#ifdef VK_KHR_draw_indirect_count
+			PFN_vkCmdDrawIndirectCountKHR m_draw_indirect_count = nullptr;
+			PFN_vkCmdDrawIndexedIndirectCountKHR m_draw_indexed_indirect_count = nullptr;
+#endif
+			std::vector<VulkanBuffer*> m_dirty_buffers;
+			std::vector<VkMappedMemoryRange> m_flush_ranges;
+			std::vector<VulkanUniformBuffer*> m_late_latches;
+			bool m_scene_changed = true;
+			std::atomic<unsigned long long> m_bind_count{ 0 };
+			std::atomic<unsigned long long> m_skipped_bind_count{ 0 };
+			// Only the pending batch is ever submitted, so it is always given the next handle
+			UploadHandle SubmitUploadBatch(VulkanUploadBatch* batch);
+			VulkanUploadBatch* m_upload_batch = nullptr;
+			// Submitted batches, oldest first
+			std::deque<VulkanUploadBatch*> m_submitted_uploads;
+			UploadHandle m_next_upload_handle = 1;
+			UploadHandle m_completed_upload_handle = 0;
+			struct FrameSubmit
+			{
+				uint64_t serial;
+				// Graphics timeline value the frame signals
+				uint64_t value;
+			};
+			// Frames that have been submitted but not seen complete, oldest first
+			std::deque<FrameSubmit> m_frames_in_flight;
+			uint64_t m_frame_serial = 0;
+			uint64_t m_completed_frame = 0;
+			struct DeferredDestroy
+			{
+				uint64_t frame;
+				UploadHandle upload;
+				std::function<void()> destroy;
+			};
+			// Destruction waiting on the GPU, in the order it was requested
+			std::deque<DeferredDestroy> m_deferred_destroys;
 		};
 	}
 }
\ No newline at end of file
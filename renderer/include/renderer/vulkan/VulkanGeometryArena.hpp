@@ -0,0 +1,63 @@
+#pragma once
+
+#include <renderer/IGeometryArena.hpp>
+#include <renderer/vulkan/VulkanStatus.hpp>
+
+#include <vector>
+#include <map>
+#include <memory>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		class VulkanDevice;
+		class VulkanVertexBuffer;
+		class VulkanIndexBuffer;
+		class VulkanUniformBuffer;
+		class VulkanGeometryArena : public IGeometryArena, public VulkanStatus
+		{
+		public:
+			VulkanGeometryArena(VulkanDevice* device, unsigned int vertex_size, unsigned int vertex_capacity, unsigned int index_capacity, unsigned int instance_capacity);
+			virtual ~VulkanGeometryArena();
+			virtual MeshRange AddMesh(void* vertices, unsigned int vertex_count, unsigned short* indices = nullptr, unsigned int index_count = 0);
+			virtual void RemoveMesh(MeshRange mesh);
+			virtual IVertexBuffer* GetVertexBuffer();
+			virtual IIndexBuffer* GetIndexBuffer();
+			virtual void AttachBuffer(unsigned int index, IUniformBuffer* buffer);
+			std::map<unsigned int, VulkanUniformBuffer*>& GetBuffers();
+			// Reserve a range of instances for a model pool, the first instance of the range is returned through first
+			// Returns false when there is no free range that large
+			bool AllocateInstances(unsigned int count, unsigned int& first);
+			// Hand a pools instance range back once every frame that could still draw it has finished
+			void ReleaseInstances(unsigned int first, unsigned int count);
+		private:
+			// First fit list of unused element ranges, neighbouring ranges are merged when they are freed
+			struct FreeRange
+			{
+				unsigned int first;
+				unsigned int count;
+			};
+			static bool AllocateRange(std::vector<FreeRange>& free_ranges, unsigned int count, unsigned int& first);
+			static void ReleaseRange(std::vector<FreeRange>& free_ranges, unsigned int first, unsigned int count);
+			// Shared with deferred releases so they stay valid if the arena is deleted before they run
+			struct FreeLists
+			{
+				std::vector<FreeRange> vertices;
+				std::vector<FreeRange> indices;
+				std::vector<FreeRange> instances;
+			};
+
+			VulkanDevice* m_device;
+			unsigned int m_vertex_size;
+			// Host copies the buffers upload from
+			std::vector<char> m_vertex_data;
+			std::vector<unsigned short> m_index_data;
+			VulkanVertexBuffer* m_vertex_buffer;
+			VulkanIndexBuffer* m_index_buffer;
+			unsigned int m_instance_capacity;
+			std::map<unsigned int, VulkanUniformBuffer*> m_buffers;
+			std::shared_ptr<FreeLists> m_free_lists;
+		};
+	}
+}
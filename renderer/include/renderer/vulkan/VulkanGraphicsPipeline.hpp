@@ -15,6 +15,8 @@ namespace Renderer
 
 		class VulkanSwapchain;
 		class VulkanModelPool;
+		class VulkanBuffer;
+		class VulkanCommandState;
 		class VulkanGraphicsPipeline : public IGraphicsPipeline, public VulkanPipeline, public VulkanStatus
 		{
 		public:
@@ -24,20 +26,54 @@ namespace Renderer
 			virtual bool CreatePipeline();
 			virtual void DestroyPipeline();
 			virtual void AttachToCommandBuffer(VkCommandBuffer & command_buffer);
+			void AttachToCommandBuffer(VulkanCommandState & state);
 			virtual void AttachModelPool(IModelPool* model_pool);
 			virtual void AttachVertexBinding(VertexBase vertex_binding);
 			virtual void UseDepth(bool depth);
 			virtual void UseCulling(bool culling);
 			virtual void DefinePrimitiveTopology(PrimitiveTopology top);
+			// Returns true when the pipeline needs re-recording, its own cached command buffers are marked for recording at the same time
 			bool HasChanged();
+			// Secondary command buffer holding this pipeline's draws for a swapchain image, recorded again only if the pipeline changed since it was last used
+			VkCommandBuffer GetCommandBuffer(uint32_t index, VkFramebuffer framebuffer);
+			// Do the work recording can not do off the main thread, returns true if the command buffer of this image needs recording
+			bool PrepareCommandBuffer(uint32_t index);
+			// Safe to call from a worker thread once prepared, pipelines record into their own command pool
+			void RecordCommandBuffer(uint32_t index, VkFramebuffer framebuffer);
+			// Free the cached command buffers once the frames using them are done, used when the swapchain images are replaced
+			void ReleaseCommandBuffers();
+			// Mark the cached command buffers for recording, used when the dynamic state they set has changed
+			void InvalidateCommandBuffers();
 		private:
 			static VkShaderStageFlagBits GetShaderStageFlag(ShaderStage stage);
 			static VkFormat GetFormat(Renderer::DataFormat format);
 			static VkVertexInputRate GetVertexInputRate(Renderer::VertexInputRate input_rate);
 
+			// Consecutive model pools that can share their bindings, drawn from one merged indirect command array
+			struct DrawGroup
+			{
+				std::vector<VulkanModelPool*> pools;
+				std::vector<VkDrawIndexedIndirectCommand> indexed_commands;
+				std::vector<VkDrawIndirectCommand> vertex_commands;
+				// Only created for groups of more than one pool, single pools draw from their own buffer
+				VulkanBuffer* indirect_buffer = nullptr;
+				// With VK_KHR_draw_indirect_count the merged buffer gets spare room and the GPU reads the number of draws from here
+				VulkanBuffer* count_buffer = nullptr;
+				uint32_t draw_count = 0;
+			};
+			void BuildDrawGroups();
+			void DestroyDrawGroups();
+			// Gather the current draw commands of a group, returns false when the draws no longer fit what was recorded
+			bool FillDrawGroup(DrawGroup& group);
+			// Copy changed draw commands, such as hidden models, into the merged arrays
+			bool UpdateDrawGroups();
+			void AttachDrawGroup(VulkanCommandState & state, DrawGroup& group);
+
 			static std::map<Renderer::ShaderStage, VkShaderStageFlagBits> m_shader_stage_flags;
 			static std::map<Renderer::DataFormat, VkFormat> m_formats;
 			static std::map<Renderer::VertexInputRate, VkVertexInputRate> m_vertex_input_rates;
+			// Spare draws allocated in merged groups that draw with a GPU count
+			static const unsigned int m_draw_group_padding;
 
 
 			VulkanSwapchain * m_swapchain;
@@ -45,6 +81,13 @@ namespace Renderer
 			std::vector<VkVertexInputBindingDescription> m_binding_descriptions;
 			std::vector<VkVertexInputAttributeDescription> m_attribute_descriptions;
 			std::vector<VulkanModelPool*> m_model_pools;
+			std::vector<DrawGroup> m_draw_groups;
+			bool m_rebuild_draw_groups = true;
+			// Owned by the pipeline so pipelines can be recorded on different threads at once
+			VkCommandPool m_command_pool = VK_NULL_HANDLE;
+			// One per swapchain image, only the primary buffer of the same image executes it so it is free whenever that primary is
+			std::vector<VkCommandBuffer> m_command_buffers;
+			std::vector<bool> m_dirty_command_buffers;
 			std::vector<VertexBase> m_vertex_bases;
 			VkPrimitiveTopology m_topology;
 			bool m_change;
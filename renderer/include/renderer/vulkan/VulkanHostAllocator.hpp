@@ -0,0 +1,63 @@
+#pragma once
+
+#include <renderer/vulkan/VulkanHeader.hpp>
+#include <renderer/MemoryStats.hpp>
+
+#include <mutex>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		// Supplies the VkAllocationCallbacks passed to every vkCreate/vkDestroy/vkAllocate/vkFree call
+		// Short lived command scope and object scope allocations are bump allocated from arenas, everything else goes to the heap
+		class VulkanHostAllocator
+		{
+		public:
+			VulkanHostAllocator();
+			~VulkanHostAllocator();
+			const VkAllocationCallbacks* GetCallbacks();
+			void GetHostMemoryStats(HostMemoryStats& stats);
+		private:
+			// Linear arena, space is only handed back once every allocation in it has been freed
+			struct HostArena
+			{
+				char* memory = nullptr;
+				size_t size = 0;
+				size_t head = 0;
+				size_t live_allocations = 0;
+			};
+			// Stored just in front of every pointer we hand out
+			struct AllocationHeader
+			{
+				// Start of the heap allocation, null when the allocation lives in an arena
+				void* raw;
+				size_t size;
+				HostArena* arena;
+				VkSystemAllocationScope scope;
+			};
+
+			void* Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+			void* Reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+			void Free(void* memory);
+			void* AllocateFromArena(HostArena& arena, size_t size, size_t alignment);
+			HostArena* GetArena(VkSystemAllocationScope scope);
+
+			static VKAPI_ATTR void* VKAPI_CALL AllocationCallback(void* user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+			static VKAPI_ATTR void* VKAPI_CALL ReallocationCallback(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+			static VKAPI_ATTR void VKAPI_CALL FreeCallback(void* user_data, void* memory);
+			static VKAPI_ATTR void VKAPI_CALL InternalAllocationCallback(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+			static VKAPI_ATTR void VKAPI_CALL InternalFreeCallback(void* user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+			static const size_t m_command_arena_size;
+			static const size_t m_object_arena_size;
+
+			VkAllocationCallbacks m_callbacks;
+			// Drivers may call back from their own threads
+			std::mutex m_mutex;
+			HostArena m_command_arena;
+			HostArena m_object_arena;
+			HostMemoryStats m_stats;
+		};
+	}
+}
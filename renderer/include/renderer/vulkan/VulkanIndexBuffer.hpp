@@ -11,17 +11,10 @@ namespace Renderer
 		class VulkanIndexBuffer : public IIndexBuffer, public VulkanBuffer
 		{
 		public:
-			VulkanIndexBuffer(VulkanDevice* device, void* dataPtr, unsigned int indexSize, unsigned int elementCount);
+			VulkanIndexBuffer(VulkanDevice* device, void* dataPtr, unsigned int indexSize, unsigned int elementCount, BufferUsageHint usage = BUFFER_USAGE_STATIC);
 			virtual ~VulkanIndexBuffer();
 
-			virtual void SetData(BufferSlot slot);
-			virtual void SetData(BufferSlot slot, unsigned int count);
-			virtual void SetData(BufferSlot slot, unsigned int startIndex, unsigned int count);
-
 		private:
-			void CreateStageingBuffer(BufferSlot slot);
-			void DestroyStagingBuffer(BufferSlot slot);
-			VulkanBuffer * m_staging_buffer;
 			static const BufferChain m_level;
 		};
 	}
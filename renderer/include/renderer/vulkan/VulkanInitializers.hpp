@@ -26,10 +26,12 @@ namespace Renderer
 
 			VkCommandPoolCreateInfo CommandPoolCreateInfo(uint32_t queue_family_index, VkCommandPoolCreateFlags flags = 0);
 
-			VkCommandBufferAllocateInfo CommandBufferAllocateInfo(VkCommandPool pool, uint32_t command_buffer_count);
+			VkCommandBufferAllocateInfo CommandBufferAllocateInfo(VkCommandPool pool, uint32_t command_buffer_count, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
 			VkCommandBufferBeginInfo CommandBufferBeginInfo(VkCommandBufferUsageFlags flag);
 
+			VkCommandBufferInheritanceInfo CommandBufferInheritanceInfo(VkRenderPass render_pass, uint32_t subpass, VkFramebuffer framebuffer);
+
 			VkSubmitInfo SubmitInfo(VkCommandBuffer& buffer);
 
 			VkSubmitInfo SubmitInfo(VkCommandBuffer* buffer, uint32_t count = 1);
@@ -62,6 +64,10 @@ namespace Renderer
 
 			VkImageMemoryBarrier ImageMemoryBarrier(VkImage& image, VkFormat& format, VkImageLayout& old_layout, VkImageLayout& new_layout);
 
+			VkMemoryBarrier MemoryBarrier(VkAccessFlags src_access, VkAccessFlags dst_access);
+
+			VkBufferMemoryBarrier BufferMemoryBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags src_access, VkAccessFlags dst_access);
+
 			VkBufferCreateInfo BufferCreateInfo(VkDeviceSize size, VkBufferUsageFlags usage);
 
 			VkDescriptorBufferInfo DescriptorBufferInfo(VkBuffer buffer, uint32_t size, VkDeviceSize & offset);
@@ -72,7 +78,7 @@ namespace Renderer
 
 			VkDescriptorSetLayoutBinding DescriptorSetLayoutBinding(VkDescriptorType type, VkShaderStageFlags stage_flags, uint32_t binding);
 
-			VkDescriptorPoolCreateInfo DescriptorPoolCreateInfo(std::vector<VkDescriptorPoolSize>& pool_sizes, uint32_t max_sets);
+			VkDescriptorPoolCreateInfo DescriptorPoolCreateInfo(std::vector<VkDescriptorPoolSize>& pool_sizes, uint32_t max_sets, VkDescriptorPoolCreateFlags flags = 0);
 
 			VkDescriptorSetLayoutCreateInfo DescriptorSetLayoutCreateInfo(std::vector<VkDescriptorSetLayoutBinding>& layout_bindings);
 
@@ -8,23 +8,32 @@ namespace Renderer
 {
 	namespace Vulkan
 	{
+		class VulkanHostAllocator;
 		class VulkanInstance : public VulkanStatus
 		{
 		public:
 			VulkanInstance();
 			~VulkanInstance();
 			VkInstance * GetInstance();
+			// Callbacks that every Vulkan object created from this instance is allocated with
+			const VkAllocationCallbacks* GetAllocationCallbacks();
+			VulkanHostAllocator* GetHostAllocator();
+			// True if the extension was enabled when the instance was created
+			bool HasExtension(const char* extension_name);
 		private:
 			void SetupLayersAndExtensions();
 			void InitVulkanInstance();
 			void DeInitVulkanInstance();
 			bool CheckLayersSupport();
+			// Extensions that are enabled if the loader supports them
+			static std::vector<const char*> GetOptionalExtensions();
 			std::vector<const char*> m_instance_extensions;
 			std::vector<const char*> m_instance_layers;
 			const uint32_t m_engine_version = VK_MAKE_VERSION(1, 0, 0);			// Engine version
 			const char* m_engine_name = "Renderer";								// Engine name
 			const uint32_t m_api_version = VK_MAKE_VERSION(1, 0, 68);				// Required API version number
 			VkInstance m_instance;
+			VulkanHostAllocator* m_host_allocator = nullptr;
 		};
 	}
 }
\ No newline at end of file
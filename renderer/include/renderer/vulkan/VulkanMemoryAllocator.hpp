@@ -0,0 +1,76 @@
+#pragma once
+
+#include <renderer/vulkan/VulkanHeader.hpp>
+#include <renderer/vulkan/VulkanStatus.hpp>
+#include <renderer/MemoryStats.hpp>
+
+#include <vector>
+#include <set>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		class VulkanDevice;
+
+		// A single VkDeviceMemory allocation that is split up between many resources using a buddy allocator
+		struct VulkanMemoryBlock
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			void* mapped_memory = nullptr;
+			uint32_t memory_type = UINT32_MAX;
+			bool linear = true;
+			// Dedicated blocks only ever hold one allocation and are released when it is freed
+			bool dedicated = false;
+			VkDeviceSize used = 0;
+			uint32_t allocation_count = 0;
+			// Free offsets for each buddy order, order n holds blocks of (1 << n) bytes
+			std::vector<std::set<VkDeviceSize>> free_lists;
+		};
+
+		// A region of device memory handed out by the allocator
+		struct VulkanAllocation
+		{
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			VkDeviceSize offset = 0;
+			VkDeviceSize size = 0;
+			void* mapped_memory = nullptr;
+			uint32_t memory_type = UINT32_MAX;
+			VkMemoryPropertyFlags property_flags = 0;
+			VulkanMemoryBlock* block = nullptr;
+			uint32_t order = 0;
+			MemoryCategory category = MEMORY_CATEGORY_OTHER;
+		};
+
+		class VulkanMemoryAllocator : public VulkanStatus
+		{
+		public:
+			VulkanMemoryAllocator(VulkanDevice* device);
+			~VulkanMemoryAllocator();
+			// Sub-allocate memory that fits the requirements, linear should be false for optimally tiled images
+			bool Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred, bool linear, VulkanAllocation& allocation, MemoryCategory category = MEMORY_CATEGORY_OTHER);
+			void Free(VulkanAllocation& allocation);
+			// Fill in the heap, memory type and category totals, heap budgets are left for the device to fill
+			void GetMemoryStats(MemoryStats& stats);
+		private:
+			VulkanMemoryBlock* CreateBlock(uint32_t memory_type, VkDeviceSize size, bool linear, bool dedicated);
+			void DestroyBlock(VulkanMemoryBlock* block);
+			bool AllocateFromBlock(VulkanMemoryBlock* block, uint32_t order, VkDeviceSize& offset);
+			void FreeToBlock(VulkanMemoryBlock* block, uint32_t order, VkDeviceSize offset);
+			void TrackAllocation(const VulkanAllocation& allocation, bool allocated);
+			std::vector<VulkanMemoryBlock*>& GetBlocks(uint32_t memory_type, bool linear);
+			uint32_t GetBlockOrder(uint32_t memory_type);
+			static uint32_t GetOrder(VkDeviceSize size);
+
+			static const uint32_t m_min_order;
+			static const uint32_t m_max_block_order;
+
+			VulkanDevice* m_device;
+			// Blocks are stored per memory type, with linear and optimal resources kept apart to respect bufferImageGranularity
+			std::vector<std::vector<VulkanMemoryBlock*>> m_blocks;
+			std::vector<MemoryTypeStats> m_type_stats;
+			MemoryCategoryStats m_category_stats[MEMORY_CATEGORY_COUNT];
+		};
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <renderer/IModel.hpp>
+#include <renderer/vulkan/VulkanSlotMap.hpp>
 
 namespace Renderer
 {
@@ -11,12 +12,15 @@ namespace Renderer
 		class VulkanModel : public IModel
 		{
 		public:
-			VulkanModel(VulkanModelPool* pool, unsigned int model_pool_index);
+			VulkanModel(VulkanModelPool* pool, VulkanSlotHandle handle);
 			virtual void ShouldRender(bool render);
 			virtual bool Rendering();
 			virtual IModelPool* GetModelPool();
+			// Handle the pool was given when the model was created, the pool index is its slot index
+			VulkanSlotHandle GetHandle();
 		private:
 			VulkanModelPool * m_pool;
+			VulkanSlotHandle m_handle;
 			bool m_rendering;
 		};
 	}
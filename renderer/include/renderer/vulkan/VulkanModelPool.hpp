@@ -1,8 +1,11 @@
 #pragma once
 
 #include <renderer/IModelPool.hpp>
+#include <renderer/IGeometryArena.hpp>
 #include <renderer/vulkan/VulkanModel.hpp>
 #include <renderer/vulkan/VulkanUniformBuffer.hpp>
+#include <renderer/vulkan/VulkanCommandState.hpp>
+#include <renderer/vulkan/VulkanSlotMap.hpp>
 
 #include <glm/glm.hpp>
 #include <map>
@@ -16,37 +19,110 @@ namespace Renderer
 		class VulkanDevice;
 		class VulkanDescriptorSet;
 		class VulkanPipeline;
+		class VulkanGeometryArena;
 		class VulkanModelPool : public IModelPool
 		{
 		public:
 			VulkanModelPool(VulkanDevice* device, IVertexBuffer* vertex_buffer);
 			VulkanModelPool(VulkanDevice* device, IVertexBuffer* vertex_buffer, IIndexBuffer* index_buffer);
+			// Draw a single mesh out of a geometry arena
+			VulkanModelPool(VulkanDevice* device, VulkanGeometryArena* geometry_arena, MeshRange mesh);
 			virtual ~VulkanModelPool();
 			virtual IModel * CreateModel();
 			virtual IModel* GetModel(int index);
 			virtual void RemoveModel(IModel* model);
+			virtual unsigned int CreateModels(unsigned int count, IModel** models);
+			virtual void RemoveModels(IModel** models, unsigned int count);
+			virtual void SetVisibility(const unsigned int* indices, const bool* visible, unsigned int count);
+			virtual void SetVisibilityMask(const std::vector<bool>& mask);
 			virtual void Update();
 			virtual void AttachBuffer(unsigned int index, IUniformBuffer * buffer);
 			virtual void UpdateModelBuffer(unsigned int index);
 			virtual void AttachDescriptorSet(unsigned int index, IDescriptorSet* descriptor_set);
 			virtual std::vector<IDescriptorSet*> GetDescriptorSets();
 			virtual void SetVertexDrawCount(unsigned int count);
+			virtual void SetInstanceRemap(bool remap);
 			virtual unsigned int GetLargestIndex(); 
-			void AttachToCommandBuffer(VkCommandBuffer & command_buffer, VulkanPipeline* pipeline);
+			void AttachToCommandBuffer(VulkanCommandState & state, VulkanPipeline* pipeline);
+			// Bind the descriptor sets, geometry and instance buffers without drawing, anything already bound is skipped
+			void AttachBindings(VulkanCommandState & state, VulkanPipeline* pipeline);
+			void AttachDraws(VkCommandBuffer & command_buffer);
+			// True when both pools come from the same geometry arena and bind the same descriptor sets,
+			// the instance buffers belong to the arena so their draw commands can be issued together after one set of bindings
+			bool CanDrawWith(VulkanModelPool* other);
+			unsigned int GetDrawCount();
+			// Append this pools draw commands to a merged command array
+			void GetDrawCommands(std::vector<VkDrawIndexedIndirectCommand>& commands);
+			void GetDrawCommands(std::vector<VkDrawIndirectCommand>& commands);
+			// True when a draw command changed since the last call, such as a model being hidden
+			bool HaveDrawsChanged();
 			bool HasChanged();
 		private:
-			void ResizeIndirectArray(unsigned int size);
+			// Element range of a buffer written during a batch, empty while first equals end
+			struct DirtyRange
+			{
+				unsigned int first = 0;
+				unsigned int end = 0;
+			};
+			// Where each attached buffer keeps the data of model 0, looked up once per create call
+			struct ModelBuffer
+			{
+				unsigned int index;
+				char* data;
+				unsigned int index_size;
+			};
+			// Bulk calls gather their buffer writes between these and make them once at the end
+			void BeginBatch();
+			void EndBatch();
+			// Write one element straight away, or add it to the range written at the end of the batch
+			void WriteElement(VulkanBuffer* buffer, DirtyRange& range, unsigned int index);
+			void UpdateModelBufferTable();
+			// The arena's buffers for pools drawing from a geometry arena, otherwise the ones attached to the pool
+			std::map<unsigned int, VulkanUniformBuffer*>& GetBuffers();
+			// Grow the arena instance range to at least size, moving the existing instance data to the new range
+			// Returns false and leaves the range as it was when the arena has no room
+			bool ReserveInstances(unsigned int size);
+			// Null when there is no room for another model
+			VulkanModel* AddModel();
+			void ReserveRemap(unsigned int size);
+			// Returns false without changing anything when an arena pool can not get the instances to go with the commands
+			bool ResizeIndirectArray(unsigned int size);
+			// True when the draws are recorded with a GPU side count, so models can come and go without recording again
+			bool UsesDrawCount();
+			// Add or remove a model from the packed list of visible models, the last visible model fills any gap
+			void UpdateInstanceRemap(unsigned int index, bool visible);
+			void UpdateRemapCommand();
 			void Render(unsigned int index, bool should_render);
 			unsigned int m_current_index;
 			unsigned int m_largest_index;
-			std::vector<unsigned int> m_free_indexs;
 			unsigned int m_vertex_draw_count;
 			VulkanDevice * m_device;
 			std::map<unsigned int, VulkanDescriptorSet*> m_descriptor_sets;
 			std::map<unsigned int, VulkanUniformBuffer*> m_buffers;
-			std::map<unsigned int, VulkanModel*> m_models;
+			// The slot index of a model is its index into the pool's buffers
+			VulkanSlotMap<VulkanModel*> m_models;
 			static const unsigned int m_indirect_array_padding;
+			std::vector<ModelBuffer> m_model_buffers;
+			bool m_batching = false;
+			DirtyRange m_dirty_commands;
+			DirtyRange m_dirty_remap;
+			bool m_remap_command_dirty = false;
+			bool m_draw_count_dirty = false;
 			VulkanBuffer* m_indirect_draw_buffer = nullptr;
+			// Number of indirect commands to draw, read by the GPU when the draw executes, null without VK_KHR_draw_indirect_count
+			VulkanBuffer* m_draw_count_buffer = nullptr;
+			uint32_t m_draw_count = 0;
+			// Instance remap, null unless enabled, the first m_visible_count entries of m_remap are the visible model indices
+			VulkanBuffer* m_remap_buffer = nullptr;
+			std::vector<uint32_t> m_remap;
+			unsigned int m_visible_count = 0;
+			// Where each model sits in m_remap, m_remap_hidden for models that are not drawn
+			std::vector<unsigned int> m_remap_positions;
+			static const unsigned int m_remap_hidden;
+			// Single command drawing all visible models
+			VulkanBuffer* m_remap_draw_buffer = nullptr;
+			VkDrawIndexedIndirectCommand m_remap_indexed_command = {};
+			VkDrawIndirectCommand m_remap_vertex_command = {};
 
 
 
@@ -61,6 +137,13 @@ namespace Renderer
 			};*/
 
 			bool m_change;
+			bool m_draws_changed = false;
+			// Null for pools that own their buffers, otherwise the arena the mesh lives in
+			VulkanGeometryArena* m_geometry_arena = nullptr;
+			MeshRange m_mesh;
+			// Instance range in the arena buffers, model i draws and reads its data at m_first_instance + i
+			unsigned int m_first_instance = 0;
+			unsigned int m_instance_count = 0;
 
 			friend VulkanModel;
 		};
@@ -14,7 +14,7 @@ namespace Renderer
 		class VulkanPhysicalDevice : public VulkanStatus
 		{
 		public:
-			VulkanPhysicalDevice(VkPhysicalDevice device, VulkanQueueFamilyIndices queue_family);
+			VulkanPhysicalDevice(VulkanInstance* instance, VkPhysicalDevice device, VulkanQueueFamilyIndices queue_family);
 
 			VkPhysicalDevice* GetPhysicalDevice();
 			VulkanQueueFamilyIndices* GetQueueFamilies();
@@ -22,11 +22,15 @@ namespace Renderer
 			VkPhysicalDeviceFeatures* GetDeviceFeatures();
 			VkPhysicalDeviceMemoryProperties* GetPhysicalDeviceMemoryProperties();
 			std::vector<const char*>* GetExtenstions();
+			// True if the extension will be enabled on the logical device
+			bool HasExtension(const char* extension_name);
 			VkFormatProperties GetFormatProperties(VkFormat format);
 
 			static VulkanPhysicalDevice* GetPhysicalDevice(VulkanInstance* instance, VkSurfaceKHR surface);
 			static std::vector<VkPhysicalDevice> GetPhysicalDevices(VulkanInstance* instance);
 			static std::vector<const char*> GetDeviceExtenstions();
+			// Extensions that are enabled when the device and instance support them
+			static std::vector<const char*> GetOptionalDeviceExtensions(VulkanInstance* instance);
 		private:
 			static bool CheckPhysicalDevice(VkPhysicalDevice& device);
 			static bool CheckDeviceExtensionSupport(VkPhysicalDevice& device);
@@ -11,6 +11,8 @@ namespace Renderer
 			uint32_t graphics_indices = UINT32_MAX;
 			uint32_t present_indices = UINT32_MAX;
 			uint32_t compute_indices = UINT32_MAX;
+			// Transfer only family used for uploads, this is the graphics family when the device has no dedicated one
+			uint32_t transfer_indices = UINT32_MAX;
 			bool isComplete()
 			{
 				return graphics_indices < UINT32_MAX &&
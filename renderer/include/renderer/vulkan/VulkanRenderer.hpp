@@ -8,6 +8,8 @@
 
 #include <glm\glm.hpp>
 
+#include <chrono>
+
 namespace Renderer
 {
 	namespace Vulkan
@@ -27,15 +29,17 @@ namespace Renderer
 		public:
 			VulkanRenderer();
 			~VulkanRenderer();
-			virtual bool Start(Renderer::NativeWindowHandle* window_handle);
+			virtual bool Start(Renderer::NativeWindowHandle* window_handle, Renderer::SwapchainConfiguration configuration = Renderer::SwapchainConfiguration());
 			virtual void Update();
 			virtual void Stop();
 			virtual void Rebuild();
-			virtual IUniformBuffer* CreateUniformBuffer(void* dataPtr, BufferChain level, unsigned int indexSize, unsigned int elementCount, bool modifiable);
+			virtual void SetMaxIdleInterval(unsigned int milliseconds);
+			virtual void RequestRedraw();
+			virtual IUniformBuffer* CreateUniformBuffer(void* dataPtr, BufferChain level, unsigned int indexSize, unsigned int elementCount, bool modifiable, BufferUsageHint usage);
 
-			virtual IVertexBuffer* CreateVertexBuffer(void* dataPtr, unsigned int indexSize, unsigned int elementCount);
+			virtual IVertexBuffer* CreateVertexBuffer(void* dataPtr, unsigned int indexSize, unsigned int elementCount, BufferUsageHint usage);
 
-			virtual IIndexBuffer* CreateIndexBuffer(void* dataPtr, unsigned int indexSize, unsigned int elementCount);
+			virtual IIndexBuffer* CreateIndexBuffer(void* dataPtr, unsigned int indexSize, unsigned int elementCount, BufferUsageHint usage);
 
 			virtual IGraphicsPipeline* CreateGraphicsPipeline(std::map<ShaderStage, const char*> paths, bool priority = false);
 
@@ -49,23 +53,46 @@ namespace Renderer
 
 			virtual IModelPool* CreateModelPool(IVertexBuffer* vertex_buffer);
 
+			virtual IGeometryArena* CreateGeometryArena(unsigned int vertex_size, unsigned int vertex_capacity, unsigned int index_capacity, unsigned int instance_capacity);
+
+			virtual IModelPool* CreateModelPool(IGeometryArena* geometry_arena, MeshRange mesh);
+
 			virtual ITextureBuffer* CreateTextureBuffer(void* dataPtr, DataFormat format, unsigned int width, unsigned int height);
 
 			virtual IDescriptor* CreateDescriptor(DescriptorType descriptor_type, ShaderStage shader_stage, unsigned int binding);
 
 			virtual IDescriptorPool* CreateDescriptorPool(std::vector<IDescriptor*> descriptors);
 
+			virtual UploadHandle SubmitUploads();
+
+			virtual bool IsUploadComplete(UploadHandle handle);
+
+			virtual void WaitForUpload(UploadHandle handle);
+
+			virtual MemoryStats GetMemoryStats();
+
+			virtual HostMemoryStats GetHostMemoryStats();
+
+			virtual CommandStats GetCommandStats();
+
+			virtual float GetResolutionScale();
+
 			static VkDescriptorType ToDescriptorType(DescriptorType descriptor_type);
 
 			static VkShaderStageFlagBits ToVulkanShader(ShaderStage stage);
 		private:
 			void CreateSurface(Renderer::NativeWindowHandle* window_handle);
+			// Whether this Update has anything new to show, or has been idle for too long
+			bool ShouldDrawFrame();
 			Renderer::NativeWindowHandle* m_window_handle;
 			VulkanInstance * m_instance;
 			VkSurfaceKHR m_surface;
 			VulkanPhysicalDevice* m_physical_device;
 			VulkanDevice* m_device;
 			VulkanSwapchain* m_swapchain;
+			unsigned int m_max_idle_interval = 0;
+			bool m_redraw_requested = true;
+			std::chrono::steady_clock::time_point m_last_frame_time;
 		};
 	}
 }
\ No newline at end of file
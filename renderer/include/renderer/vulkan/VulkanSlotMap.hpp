@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		// Refers to a slot map entry, the generation stops a handle to a removed entry finding whatever reused its slot
+		struct VulkanSlotHandle
+		{
+			uint32_t index = 0;
+			uint32_t generation = 0;
+		};
+		// Values are kept packed so iterating them never touches an empty slot, each slot points at its packed value
+		// Insert and remove are constant time, removing moves the last value into the gap and freed slots are reused newest first
+		template <class T>
+		class VulkanSlotMap
+		{
+		public:
+			VulkanSlotHandle Insert(const T& value);
+			// Returns false if the handle is stale
+			bool Remove(VulkanSlotHandle handle);
+			bool Contains(VulkanSlotHandle handle) const;
+			// Null when the handle is stale
+			T* Get(VulkanSlotHandle handle);
+			// Look a value up by slot index alone, null for empty slots
+			T* GetAt(uint32_t index);
+			size_t Size() const;
+			// One past the highest slot index handed out so far
+			uint32_t GetSlotCount() const;
+			typename std::vector<T>::iterator begin();
+			typename std::vector<T>::iterator end();
+		private:
+			struct Slot
+			{
+				uint32_t value_index = 0;
+				uint32_t generation = 0;
+				bool occupied = false;
+			};
+			std::vector<Slot> m_slots;
+			std::vector<uint32_t> m_free_slots;
+			std::vector<T> m_values;
+			// Slot of each packed value, used to point the slot of the moved value at its new place
+			std::vector<uint32_t> m_value_slots;
+		};
+
+		template<class T>
+		inline VulkanSlotHandle VulkanSlotMap<T>::Insert(const T & value)
+		{
+			uint32_t index;
+			if (m_free_slots.size() > 0)
+			{
+				index = m_free_slots.back();
+				m_free_slots.pop_back();
+			}
+			else
+			{
+				index = (uint32_t)m_slots.size();
+				m_slots.push_back(Slot());
+			}
+			Slot& slot = m_slots[index];
+			slot.value_index = (uint32_t)m_values.size();
+			slot.occupied = true;
+			m_values.push_back(value);
+			m_value_slots.push_back(index);
+
+			VulkanSlotHandle handle;
+			handle.index = index;
+			handle.generation = slot.generation;
+			return handle;
+		}
+
+		template<class T>
+		inline bool VulkanSlotMap<T>::Remove(VulkanSlotHandle handle)
+		{
+			if (!Contains(handle)) return false;
+			Slot& slot = m_slots[handle.index];
+			uint32_t last = (uint32_t)m_values.size() - 1;
+			if (slot.value_index != last)
+			{
+				m_values[slot.value_index] = m_values[last];
+				m_value_slots[slot.value_index] = m_value_slots[last];
+				m_slots[m_value_slots[last]].value_index = slot.value_index;
+			}
+			m_values.pop_back();
+			m_value_slots.pop_back();
+			slot.occupied = false;
+			// Any handle still pointing at the slot is now stale
+			slot.generation++;
+			m_free_slots.push_back(handle.index);
+			return true;
+		}
+
+		template<class T>
+		inline bool VulkanSlotMap<T>::Contains(VulkanSlotHandle handle) const
+		{
+			return handle.index < m_slots.size() &&
+				m_slots[handle.index].occupied &&
+				m_slots[handle.index].generation == handle.generation;
+		}
+
+		template<class T>
+		inline T * VulkanSlotMap<T>::Get(VulkanSlotHandle handle)
+		{
+			if (!Contains(handle)) return nullptr;
+			return &m_values[m_slots[handle.index].value_index];
+		}
+
+		template<class T>
+		inline T * VulkanSlotMap<T>::GetAt(uint32_t index)
+		{
+			if (index >= m_slots.size() || !m_slots[index].occupied) return nullptr;
+			return &m_values[m_slots[index].value_index];
+		}
+
+		template<class T>
+		inline size_t VulkanSlotMap<T>::Size() const
+		{
+			return m_values.size();
+		}
+
+		template<class T>
+		inline uint32_t VulkanSlotMap<T>::GetSlotCount() const
+		{
+			return (uint32_t)m_slots.size();
+		}
+
+		template<class T>
+		inline typename std::vector<T>::iterator VulkanSlotMap<T>::begin()
+		{
+			return m_values.begin();
+		}
+
+		template<class T>
+		inline typename std::vector<T>::iterator VulkanSlotMap<T>::end()
+		{
+			return m_values.end();
+		}
+	}
+}
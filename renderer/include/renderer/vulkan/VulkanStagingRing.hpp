@@ -0,0 +1,46 @@
+#pragma once
+
+#include <renderer/vulkan/VulkanHeader.hpp>
+#include <renderer/vulkan/VulkanStatus.hpp>
+#include <renderer/vulkan/VulkanBufferData.hpp>
+
+#include <deque>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		class VulkanDevice;
+		// Persistently mapped host buffer that uploads are written into before being copied to the GPU
+		class VulkanStagingRing : public VulkanStatus
+		{
+		public:
+			VulkanStagingRing(VulkanDevice* device, VkDeviceSize size);
+			~VulkanStagingRing();
+			// Reserve space in the ring, returns false if the ring is too full right now
+			bool Allocate(VkDeviceSize size, VkDeviceSize& offset, uint64_t& region);
+			// Give a region back once the GPU has finished reading it, space is reused in the order it was handed out
+			void Release(uint64_t region);
+			void* GetMappedMemory(VkDeviceSize offset);
+			VkBuffer GetBuffer();
+			VkDeviceSize GetSize();
+		private:
+			static const VkDeviceSize m_alignment;
+
+			VulkanDevice* m_device;
+			VulkanBufferData m_ring_buffer;
+			VkDeviceSize m_size;
+			VkDeviceSize m_head;
+			VkDeviceSize m_used;
+
+			struct StagingRegion
+			{
+				VkDeviceSize bytes;
+				bool released;
+			};
+			// Regions in the order they were allocated, the front one is the tail of the ring
+			std::deque<StagingRegion> m_regions;
+			uint64_t m_front_region;
+		};
+	}
+}
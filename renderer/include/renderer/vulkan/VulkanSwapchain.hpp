@@ -1,10 +1,12 @@
 #pragma once
 
 #include <renderer/vulkan/VulkanHeader.hpp>
+#include <renderer/SwapchainConfiguration.hpp>
 
 #include <renderer/vulkan/VulkanInitializers.hpp>
 #include <renderer/vulkan/VulkanStatus.hpp>
 #include <renderer/vulkan/VulkanSwapChainSupport.hpp>
+#include <renderer/vulkan/VulkanMemoryAllocator.hpp>
 
 namespace Renderer
 {
@@ -14,12 +16,15 @@ namespace Renderer
 		class VulkanInstance;
 		class VulkanDevice;
 		class VulkanGraphicsPipeline;
+		class VulkanThreadPool;
 		class VulkanSwapchain : public VulkanStatus
 		{
 		public:
-			VulkanSwapchain(VulkanInstance* instance, VulkanDevice* device, VkSurfaceKHR* surface, Renderer::NativeWindowHandle* window_handle);
+			VulkanSwapchain(VulkanInstance* instance, VulkanDevice* device, VkSurfaceKHR* surface, Renderer::NativeWindowHandle* window_handle, Renderer::SwapchainConfiguration configuration = Renderer::SwapchainConfiguration());
 			~VulkanSwapchain();
 			void RequestRebuildCommandBuffers();
+			// Bursts of requests, such as a window being drag resized, are folded into one rebuild at the start of the next frame
+			void RequestRebuildSwapchain();
 			void RebuildSwapchain();
 			unsigned int GetCurrentBuffer();
 			VkSubmitInfo GetSubmitInfo();
@@ -31,6 +36,8 @@ namespace Renderer
 			VkSurfaceFormatKHR GetSurfaceFormat();
 			VkPresentModeKHR GetSurfacePresentMode();
 			void AttachGraphicsPipeline(VulkanGraphicsPipeline* pipeline, bool priority = false);
+			// Line width, viewport and scissor, every command buffer drawing into the render pass has to set these itself
+			void AttachDynamicState(VkCommandBuffer& command_buffer);
 			void RemoveGraphicsPipeline(VulkanGraphicsPipeline* pipeline);
 
 			uint32_t GetImageCount();
@@ -43,11 +50,19 @@ namespace Renderer
 			VkFormat GetSwapChainImageFormat();
 			VkImage GetDepthImage();
 			VkExtent2D GetSwapchainExtent();
+			// Scale the scene is currently rendered at, always 1 unless dynamic resolution is in use
+			float GetResolutionScale();
 		private:
 
+			// Mark every command buffer for recording, each one is recorded again the next time its image is acquired
 			void RebuildCommandBuffers();
+			void RecordCommandBuffer(uint32_t index);
+			// Record the late latch copies of the current frame, returns false when no uniform buffer is latched
+			bool RecordLateLatches();
 			void CreateSwapchain();
 			void DestroySwapchain();
+			// Hand the images, framebuffers and depth image of a replaced swapchain to the device, they are destroyed once the frames using them are done
+			void RetireSwapchain(VkSwapchainKHR old_swap_chain);
 
 			void InitSwapchain();
 			void DeInitSwapchain();
@@ -55,6 +70,9 @@ namespace Renderer
 			VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats);
 			VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> available_present_modes);
 			VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR & capabilities);
+			uint32_t ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR & capabilities);
+			// Dynamic resolution needs frame timestamps and blits from the offscreen target into the swapchain images
+			bool SupportsDynamicResolution(const VulkanSwapChainSupport & support);
 
 			// Swapchain images
 			void InitSwapchainImages();
@@ -75,6 +93,15 @@ namespace Renderer
 			void InitFrameBuffer();
 			void DeInitFrameBuffer();
 
+			// Offscreen target, render pass and timestamp queries used by dynamic resolution
+			void InitOffscreenTarget();
+			void DeInitOffscreenTarget();
+			// Filter the rendered part of the offscreen target up to the swapchain image and hand the target back for the next frame
+			void RecordOffscreenBlit(VkCommandBuffer command_buffer, uint32_t index);
+			// Read back the GPU time of the image's last frame and move the scale towards the target, changing step records the command buffers again
+			void UpdateResolutionScale(uint32_t index);
+			void UpdateRenderExtent();
+
 			// Semaphores
 			void InitSemaphores();
 			void DeInitSemaphores();
@@ -86,8 +113,10 @@ namespace Renderer
 			VkPresentModeKHR present_mode;
 
 			Renderer::NativeWindowHandle* m_window_handle;
+			Renderer::SwapchainConfiguration m_configuration;
 
-			VkSwapchainKHR m_swap_chain;
+			VkSwapchainKHR m_swap_chain = VK_NULL_HANDLE;
+			bool m_should_rebuild_swapchain = false;
 			std::vector<VkImage> m_swap_chain_images;
 			std::vector<VkImageView> m_swap_chain_image_views;
 			std::vector<VkFramebuffer> m_swap_chain_framebuffers;
@@ -105,14 +134,48 @@ namespace Renderer
 
 			// Depth image
 			VkImage m_depth_image;
-			VkDeviceMemory m_depth_image_memory;
+			VulkanAllocation m_depth_image_memory;
 			VkImageView m_depth_image_view;
 
-			// Semaphores
-			VkSemaphore m_image_available_semaphore;
-			VkSemaphore m_render_finished_semaphore;
+			// Semaphores, one set per frame in flight so the CPU can record a frame while the GPU works on the last
+			struct FrameSync
+			{
+				VkSemaphore image_available;
+				VkSemaphore render_finished;
+				// Copies late latched uniforms in ahead of the frame, allocated the first time there is something to latch
+				VkCommandBuffer latch_commands = VK_NULL_HANDLE;
+				// Device frame serial of the last submit that used these semaphores
+				uint64_t serial = 0;
+			};
+			std::vector<FrameSync> m_frames;
+			unsigned int m_current_frame = 0;
+			static const unsigned int m_max_frames_in_flight;
+			// Device frame serial that last rendered to each swapchain image, its command buffer is not reset before that frame is done
+			std::vector<uint64_t> m_image_frames;
+			std::vector<bool> m_dirty_command_buffers;
+
+			// Dynamic resolution, the offscreen target is as large as the swapchain and only the render extent of it is drawn to
+			bool m_dynamic_resolution = false;
+			VkRenderPass m_offscreen_render_pass = VK_NULL_HANDLE;
+			VkImage m_offscreen_image = VK_NULL_HANDLE;
+			VulkanAllocation m_offscreen_image_memory;
+			VkImageView m_offscreen_image_view = VK_NULL_HANDLE;
+			VkFramebuffer m_offscreen_framebuffer = VK_NULL_HANDLE;
+			VkFilter m_blit_filter = VK_FILTER_LINEAR;
+			// Two timestamps per swapchain image, written at the start and end of its command buffer
+			VkQueryPool m_timestamp_pool = VK_NULL_HANDLE;
+			std::vector<bool> m_timestamps_pending;
+			// Smoothed GPU frame time in milliseconds, 0 until the first frame is timed
+			float m_gpu_frame_time = 0.0f;
+			// The controller moves the scale freely, the applied scale only changes in whole steps so recording again stays rare
+			float m_resolution_scale = 1.0f;
+			float m_applied_resolution_scale = 1.0f;
+			static const float m_resolution_scale_step;
+			VkExtent2D m_render_extent;
 
 			std::vector<VulkanGraphicsPipeline*> m_pipelines;
+			// Changed pipelines record their secondary command buffers in parallel on these
+			VulkanThreadPool* m_recording_threads = nullptr;
 
 			VkPipelineStageFlags* m_wait_stages;
 
@@ -30,11 +30,12 @@ namespace Renderer
 			unsigned int m_height;
 			int m_mipLevels;
 
-			VkImage m_image;
-			VkSampler m_sampler;
-			VkImageView m_view;
+			VkImage m_image = VK_NULL_HANDLE;
+			VkSampler m_sampler = VK_NULL_HANDLE;
+			VkImageView m_view = VK_NULL_HANDLE;
 			VkImageLayout m_image_layout;
-			VkDeviceMemory m_device_memory;
+			bool m_graphics_owned = false;
+			VulkanAllocation m_device_memory;
 			std::vector<VkBufferImageCopy> m_bufferCopyRegions;
 		};
 	}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		// Persistent worker threads that command recording is spread across
+		// Run hands out a batch of jobs and the calling thread works through them too, so a pool with no threads runs everything in place
+		class VulkanThreadPool
+		{
+		public:
+			VulkanThreadPool(unsigned int thread_count);
+			~VulkanThreadPool();
+			// Run every job and return once they have all finished
+			void Run(const std::vector<std::function<void()>>& jobs);
+			unsigned int GetThreadCount();
+			// One worker per hardware thread, less the one that calls Run
+			static unsigned int GetDefaultThreadCount();
+		private:
+			void WorkerLoop();
+			// Take and run jobs until none are left to start, expects the lock to be held
+			void RunJobs(std::unique_lock<std::mutex>& lock);
+
+			std::vector<std::thread> m_threads;
+			std::mutex m_mutex;
+			std::condition_variable m_work_ready;
+			std::condition_variable m_work_done;
+			const std::vector<std::function<void()>>* m_jobs = nullptr;
+			size_t m_job_count = 0;
+			size_t m_next_job = 0;
+			size_t m_remaining_jobs = 0;
+			bool m_stop = false;
+		};
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <renderer/vulkan/VulkanHeader.hpp>
+#include <renderer/vulkan/VulkanStatus.hpp>
+
+#include <vector>
+#include <deque>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		class VulkanDevice;
+		class VulkanTimeline;
+		// A value on a queue timeline, reached once the submit that signalled it has finished
+		struct VulkanTimelinePoint
+		{
+			VulkanTimeline* timeline = nullptr;
+			uint64_t value = 0;
+		};
+		struct VulkanSubmission
+		{
+			std::vector<VkCommandBuffer> command_buffers;
+			// Points on other timelines this submit waits for, and the stage that waits on each
+			std::vector<VulkanTimelinePoint> wait_points;
+			std::vector<VkPipelineStageFlags> wait_point_stages;
+			// Binary semaphores for the swapchain and for chains of submits that know their waiter up front
+			std::vector<VkSemaphore> wait_semaphores;
+			std::vector<VkPipelineStageFlags> wait_semaphore_stages;
+			std::vector<VkSemaphore> signal_semaphores;
+		};
+		// Every submit to a queue signals the next value on that queue's timeline, the CPU and other queues can wait on or poll any value
+		// Uses a VK_KHR_timeline_semaphore when the device has one, otherwise each submit gets a fence and waits across queues happen on the CPU
+		class VulkanTimeline : public VulkanStatus
+		{
+		public:
+			VulkanTimeline(VulkanDevice* device, VkQueue queue);
+			~VulkanTimeline();
+			VulkanTimelinePoint Submit(const VulkanSubmission& submission);
+			bool IsComplete(uint64_t value);
+			void Wait(uint64_t value);
+			// Wait for everything submitted so far
+			void WaitIdle();
+			uint64_t GetSubmittedValue();
+			uint64_t GetCompletedValue();
+			VkQueue GetQueue();
+			bool UsesTimelineSemaphore();
+		private:
+			// Move the completed value on from the fences that have signalled, waiting up to value if asked to
+			void RetireFences(bool wait, uint64_t value);
+			VkFence GetFence();
+
+			VulkanDevice* m_device;
+			VkQueue m_queue;
+			uint64_t m_submitted_value = 0;
+			uint64_t m_completed_value = 0;
+			// Null when falling back to fences
+			VkSemaphore m_semaphore = VK_NULL_HANDLE;
+#ifdef VK_KHR_timeline_semaphore
+			PFN_vkGetSemaphoreCounterValueKHR m_get_semaphore_counter_value = nullptr;
+			PFN_vkWaitSemaphoresKHR m_wait_semaphores = nullptr;
+#endif
+			struct PendingFence
+			{
+				uint64_t value;
+				VkFence fence;
+			};
+			// Fences of submits that have not been seen complete, oldest first
+			std::deque<PendingFence> m_pending_fences;
+			std::vector<VkFence> m_free_fences;
+		};
+	}
+}
@@ -12,12 +12,28 @@ namespace Renderer
 		{
 		public:
 
-			VulkanUniformBuffer(VulkanDevice* device, BufferChain level, void* dataPtr, unsigned int indexSize, unsigned int elementCount,bool modifiable);
+			VulkanUniformBuffer(VulkanDevice* device, BufferChain level, void* dataPtr, unsigned int indexSize, unsigned int elementCount, bool modifiable, BufferUsageHint usage = BUFFER_USAGE_DYNAMIC);
 			virtual ~VulkanUniformBuffer();
 
 			virtual void GetData(BufferSlot slot);
 			virtual void GetData(BufferSlot slot,unsigned int count);
 			virtual void GetData(BufferSlot slot, unsigned int startIndex, unsigned int count);
+			virtual void SetLateLatch(BufferSlot slot, std::function<void(void* data)> callback);
+			virtual void ClearLateLatch();
+			// Run the callback, store the result in the region of this frame and record its copy into the latched slot
+			void LateLatch(VkCommandBuffer command_buffer, unsigned int frame);
+			// Run the callback and compare the result with the data the last frame was latched with
+			// A changed result is kept, so the frame drawn because of it latches the same data rather than running the callback again
+			bool HasLateLatchChanged();
+		private:
+			BufferSlot m_latch_slot = Primary;
+			std::function<void(void* data)> m_latch_callback;
+			// Host memory with one region per frame in flight, a region is only rewritten once the frame that copied from it is done
+			VulkanBufferData m_latch_buffer;
+			std::vector<char> m_latched_data;
+			// Set when HasLateLatchChanged has already filled the local data for the next LateLatch
+			bool m_latch_ready = false;
+			static const unsigned int m_latch_frames;
 		};
 	}
 }
\ No newline at end of file
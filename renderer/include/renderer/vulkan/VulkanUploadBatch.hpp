@@ -0,0 +1,79 @@
+#pragma once
+
+#include <renderer/vulkan/VulkanHeader.hpp>
+#include <renderer/vulkan/VulkanStatus.hpp>
+#include <renderer/vulkan/VulkanBufferData.hpp>
+#include <renderer/vulkan/VulkanTimeline.hpp>
+#include <renderer/UploadHandle.hpp>
+
+#include <vector>
+#include <set>
+
+namespace Renderer
+{
+	namespace Vulkan
+	{
+		class VulkanDevice;
+		// Records many copies and layout transitions into a single command buffer that is submitted once
+		// Completion is tracked by the timeline point of the submit (GetPoint), a fence is only used when timeline semaphores are unavailable
+		// When the device has a dedicated transfer queue, staged uploads run on it and ownership is handed back to the graphics queue
+		class VulkanUploadBatch : public VulkanStatus
+		{
+		public:
+			VulkanUploadBatch(VulkanDevice* device);
+			~VulkanUploadBatch();
+
+			// Copy host data into a buffer through the staging ring
+			// graphics_owned tracks whether the graphics queue holds the buffer and is set once the upload hands it over
+			void Upload(VkBuffer to_buffer, VkDeviceSize to_offset, const void* data, VkDeviceSize size, bool* graphics_owned = nullptr);
+			// Replace the contents of an image through the staging ring, leaving it in final_layout for the graphics queue
+			void UploadImage(VkImage image, const void* data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions, VkImageSubresourceRange subresource_range, VkImageLayout final_layout, bool* graphics_owned = nullptr);
+
+			// These run on the graphics queue after any transfer queue work in the batch
+			void CopyBuffer(VkBuffer from_buffer, VkBuffer to_buffer, VkDeviceSize size, VkDeviceSize from_offset = 0, VkDeviceSize to_offset = 0);
+			void CopyBufferToImage(VkBuffer from_buffer, VkImage image, std::vector<VkBufferImageCopy>& regions);
+			void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
+			void SetImageLayout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkImageSubresourceRange subresource_range);
+
+			bool HasCommands();
+			UploadHandle GetHandle();
+			// Timeline point of the last submit in the batch, everything in the batch is done once it is reached
+			VulkanTimelinePoint GetPoint();
+
+			// Used by the device to hand the batch to the GPU and track it
+			void Submit(UploadHandle handle);
+			bool IsComplete();
+			void Wait();
+		private:
+			// Command buffer run before the transfer work on the graphics queue, used to release buffers the graphics queue owns
+			VkCommandBuffer GetReleaseCommandBuffer();
+			// Command buffer for staged copies, on the transfer queue when there is a dedicated one
+			VkCommandBuffer GetTransferCommandBuffer();
+			// Command buffer run on the graphics queue after the transfer work
+			VkCommandBuffer GetGraphicsCommandBuffer();
+			VkCommandBuffer BeginCommandBuffer(bool transfer);
+			// Find space for size bytes of staging data, falls back to a dedicated buffer when the ring is full
+			VkBuffer Stage(const void* data, VkDeviceSize size, VkDeviceSize& offset);
+			// Hand a buffer from the graphics family to the transfer family if needed, and back again at the end of the batch
+			void AcquireBuffer(VkBuffer buffer, bool* graphics_owned);
+			VkSemaphore CreateBatchSemaphore();
+
+			VulkanDevice* m_device;
+			bool m_dedicated_transfer;
+			VkCommandBuffer m_release_command_buffer = VK_NULL_HANDLE;
+			VkCommandBuffer m_transfer_command_buffer = VK_NULL_HANDLE;
+			VkCommandBuffer m_graphics_command_buffer = VK_NULL_HANDLE;
+			// Set when the transfer work has to wait for earlier graphics work to finish with a resource
+			bool m_wait_for_graphics = false;
+			std::vector<VkSemaphore> m_semaphores;
+			VulkanTimelinePoint m_point;
+			bool m_submitted = false;
+			UploadHandle m_handle = 0;
+			// Buffers written on the transfer queue that are handed to the graphics queue on submit
+			std::set<VkBuffer> m_transfer_buffers;
+			// Staging ring regions and overflow buffers that must live until the GPU is done
+			std::vector<uint64_t> m_ring_regions;
+			std::vector<VulkanBufferData> m_overflow_buffers;
+		};
+	}
+}
@@ -11,17 +11,10 @@ namespace Renderer
 		class VulkanVertexBuffer : public IVertexBuffer, public VulkanBuffer
 		{
 		public:
-			VulkanVertexBuffer(VulkanDevice* device, void* dataPtr, unsigned int indexSize, unsigned int elementCount);
+			VulkanVertexBuffer(VulkanDevice* device, void* dataPtr, unsigned int indexSize, unsigned int elementCount, BufferUsageHint usage = BUFFER_USAGE_STATIC);
 			virtual ~VulkanVertexBuffer();
 
-			virtual void SetData(BufferSlot slot);
-			virtual void SetData(BufferSlot slot, unsigned int count);
-			virtual void SetData(BufferSlot slot, unsigned int startIndex, unsigned int count);
-
 		private:
-			void CreateStageingBuffer(BufferSlot slot);
-			void DestroyStagingBuffer(BufferSlot slot);
-			VulkanBuffer * m_staging_buffer;
 			static const BufferChain m_level;
 		};
 	}
@@ -1,18 +1,26 @@
 #include <renderer/IModel.hpp>
 #include <renderer\IModelPool.hpp>
 
+#include <assert.h>
+
 Renderer::IModel::IModel(unsigned int model_pool_index)
 {
 	m_model_pool_index = model_pool_index;
+	for (unsigned int i = 0; i < MAX_MODEL_BUFFERS; i++)
+	{
+		m_data_pointers[i] = nullptr;
+	}
 }
 
 void Renderer::IModel::SetDataPointer(unsigned int index, void * data)
 {
+	assert(index < MAX_MODEL_BUFFERS && "Model buffer index out of range");
 	m_data_pointers[index] = data;
 }
 
 void Renderer::IModel::SetData(unsigned int index, void * data, unsigned int size)
 {
+	assert(index < MAX_MODEL_BUFFERS && m_data_pointers[index] && "No buffer attached at this model buffer index");
 	memcpy(m_data_pointers[index], data, size);
 }
 
@@ -1,7 +1,10 @@
 #include <renderer/vulkan/VulkanBuffer.hpp>
 #include <renderer/vulkan/VulkanCommon.hpp>
+#include <renderer/vulkan/VulkanUploadBatch.hpp>
 
-Renderer::Vulkan::VulkanBuffer::VulkanBuffer(VulkanDevice * device, BufferChain level, void * dataPtr, unsigned int indexSize, unsigned int elementCount, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_propertys_flag) :
+#include <algorithm>
+
+Renderer::Vulkan::VulkanBuffer::VulkanBuffer(VulkanDevice * device, BufferChain level, void * dataPtr, unsigned int indexSize, unsigned int elementCount, VkBufferUsageFlags usage, VkMemoryPropertyFlags memory_propertys_flag, VkMemoryPropertyFlags preferred_propertys_flag) :
 	IBuffer(level)
 {
 	m_device = device;
@@ -11,6 +14,7 @@ Renderer::Vulkan::VulkanBuffer::VulkanBuffer(VulkanDevice * device, BufferChain
 	if (level>BufferChain::Single) m_usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 	if (level>BufferChain::Single) m_usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 	m_memory_propertys_flag = memory_propertys_flag;
+	m_preferred_propertys_flag = preferred_propertys_flag;
 
 	for (unsigned int slot = 0; slot <= (unsigned int)level; slot++)
 	{
@@ -21,12 +25,15 @@ Renderer::Vulkan::VulkanBuffer::VulkanBuffer(VulkanDevice * device, BufferChain
 		m_local_allocation[slot].elementCount = elementCount;
 		// Setup GPU data
 		CreateBuffer((BufferSlot)slot);
-		m_gpu_allocation[slot].mapped = true;
 	}
 }
 
 Renderer::Vulkan::VulkanBuffer::~VulkanBuffer()
 {
+	if (m_flush_registered)
+	{
+		m_device->UnregisterBuffer(this);
+	}
 	for (unsigned int slot = 0; slot <= (unsigned int)m_level; slot++)
 	{
 		DestroyBuffer((BufferSlot)slot);
@@ -36,35 +43,55 @@ Renderer::Vulkan::VulkanBuffer::~VulkanBuffer()
 
 void Renderer::Vulkan::VulkanBuffer::SetData(BufferSlot slot)
 {
+	m_device->MarkSceneChanged();
+	// Memory the CPU can not see has to go through the staging ring
+	if (!m_gpu_allocation[(unsigned int)slot].mapped)
+	{
+		StageData(slot, 0, m_local_allocation[(unsigned int)slot].elementCount);
+		return;
+	}
 	memcpy(
 		m_gpu_allocation[(unsigned int)slot].buffer.mapped_memory, 
 		m_local_allocation[(unsigned int)slot].dataPtr,
 		(::size_t)m_local_allocation[(unsigned int)slot].bufferSize
 	);
-	Flush(slot);
+	MarkDirty(slot, 0, m_local_allocation[(unsigned int)slot].bufferSize);
 }
 
 void Renderer::Vulkan::VulkanBuffer::SetData(BufferSlot slot, unsigned int count)
 {
+	m_device->MarkSceneChanged();
+	if (!m_gpu_allocation[(unsigned int)slot].mapped)
+	{
+		StageData(slot, 0, count);
+		return;
+	}
 	memcpy(
 		m_gpu_allocation[(unsigned int)slot].buffer.mapped_memory, 
 		m_local_allocation[(unsigned int)slot].dataPtr, 
 		(::size_t)m_local_allocation[(unsigned int)slot].indexSize * count
 	);
-	Flush(slot);
+	MarkDirty(slot, 0, (VkDeviceSize)m_local_allocation[(unsigned int)slot].indexSize * count);
 }
 
 void Renderer::Vulkan::VulkanBuffer::SetData(BufferSlot slot, unsigned int startIndex, unsigned int count)
 {
+	m_device->MarkSceneChanged();
+	if (!m_gpu_allocation[(unsigned int)slot].mapped)
+	{
+		StageData(slot, startIndex, count);
+		return;
+	}
 	memcpy(((char*)m_gpu_allocation[(unsigned int)slot].buffer.mapped_memory) + (startIndex * m_local_allocation[(unsigned int)slot].indexSize),
 		((char*)m_local_allocation[(unsigned int)slot].dataPtr) + (startIndex * m_local_allocation[(unsigned int)slot].indexSize),
 		(::size_t)m_local_allocation[(unsigned int)slot].indexSize * count
 	);
-	Flush(slot);
+	MarkDirty(slot, (VkDeviceSize)startIndex * m_local_allocation[(unsigned int)slot].indexSize, (VkDeviceSize)m_local_allocation[(unsigned int)slot].indexSize * count);
 }
 
 void Renderer::Vulkan::VulkanBuffer::Resize(BufferSlot slot, void * dataPtr, unsigned int elementCount)
 {
+	m_device->MarkSceneChanged();
 	m_local_allocation[(unsigned int)slot].dataPtr = dataPtr;
 	m_local_allocation[(unsigned int)slot].bufferSize = m_local_allocation[(unsigned int)slot].indexSize * elementCount;
 	m_local_allocation[(unsigned int)slot].elementCount = elementCount;
@@ -74,9 +101,12 @@ void Renderer::Vulkan::VulkanBuffer::Resize(BufferSlot slot, void * dataPtr, uns
 
 void Renderer::Vulkan::VulkanBuffer::Transfer(BufferSlot to, BufferSlot from)
 {
+	m_device->MarkSceneChanged();
 	//IBuffer::Transfer(s1, s2);
 	//memcpy(m_gpu_allocation + (unsigned int)s1, m_gpu_allocation + (unsigned int)s2, sizeof(GpuBufferAllocation));
-	
+
+	// The copy reads from GPU memory, so any host writes need to be flushed first
+	m_device->FlushMappedRanges();
 	VulkanCommon::CopyBuffer(m_device, m_gpu_allocation[from].buffer.buffer, m_gpu_allocation[to].buffer.buffer, m_local_allocation[to].bufferSize);
 
 
@@ -104,9 +134,20 @@ void Renderer::Vulkan::VulkanBuffer::CreateBuffer(BufferSlot slot)
 		m_local_allocation[slot].indexSize * m_local_allocation[slot].elementCount,
 		m_usage, 
 		m_memory_propertys_flag,
-		m_gpu_allocation[slot].buffer
+		m_gpu_allocation[slot].buffer,
+		m_preferred_propertys_flag
 	);
-	VulkanCommon::MapBufferMemory(m_device, m_gpu_allocation[slot].buffer, m_gpu_allocation[slot].buffer.size);
+	m_gpu_allocation[slot].graphics_owned = false;
+	// Only host visible memory can be mapped, everything else is written through the staging ring
+	if (m_gpu_allocation[slot].buffer.allocation.property_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		VulkanCommon::MapBufferMemory(m_device, m_gpu_allocation[slot].buffer, m_gpu_allocation[slot].buffer.size);
+		m_gpu_allocation[slot].mapped = true;
+	}
+	else
+	{
+		m_gpu_allocation[slot].mapped = false;
+	}
 }
 
 void Renderer::Vulkan::VulkanBuffer::DestroyBuffer(BufferSlot slot)
@@ -115,15 +156,133 @@ void Renderer::Vulkan::VulkanBuffer::DestroyBuffer(BufferSlot slot)
 	{
 		VulkanCommon::UnMapBufferMemory(m_device, m_gpu_allocation[slot].buffer);
 	}
-	VulkanCommon::DestroyBuffer(m_device, m_gpu_allocation[slot].buffer);
+	// Frames in flight and staged copies may still use the old buffer, so it is released once they are done
+	VulkanDevice* device = m_device;
+	VulkanBufferData buffer = m_gpu_allocation[slot].buffer;
+	m_device->DeferDestroy([device, buffer]() mutable
+	{
+		VulkanCommon::DestroyBuffer(device, buffer);
+	});
+	m_gpu_allocation[slot].buffer = VulkanBufferData();
+	m_gpu_allocation[slot].dirty_ranges.clear();
 }
 
-void Renderer::Vulkan::VulkanBuffer::Flush(BufferSlot slot)
+void Renderer::Vulkan::VulkanBuffer::MarkDirty(BufferSlot slot, VkDeviceSize offset, VkDeviceSize size)
 {
+	// Coherent memory never needs flushing
+	if (m_gpu_allocation[(unsigned int)slot].buffer.allocation.property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
+	if (size == 0) return;
+	m_gpu_allocation[(unsigned int)slot].dirty_ranges.push_back({ offset, size });
+	if (!m_flush_registered)
+	{
+		m_device->RegisterDirtyBuffer(this);
+		m_flush_registered = true;
+	}
+}
+
+void Renderer::Vulkan::VulkanBuffer::CollectFlushRanges(std::vector<VkMappedMemoryRange>& ranges, VkDeviceSize atom_size)
+{
+	m_flush_registered = false;
+	for (unsigned int slot = 0; slot <= (unsigned int)m_level; slot++)
+	{
+		std::vector<DirtyRange>& dirty_ranges = m_gpu_allocation[slot].dirty_ranges;
+		if (dirty_ranges.empty()) continue;
+		VulkanAllocation& allocation = m_gpu_allocation[slot].buffer.allocation;
+
+		std::sort(dirty_ranges.begin(), dirty_ranges.end(), [](const DirtyRange& a, const DirtyRange& b) { return a.offset < b.offset; });
+
+		// Grow each range out to the atom size and merge any that now touch
+		std::vector<DirtyRange> merged;
+		for (auto& range : dirty_ranges)
+		{
+			VkDeviceSize start = range.offset & ~(atom_size - 1);
+			VkDeviceSize end = (range.offset + range.size + atom_size - 1) & ~(atom_size - 1);
+			if (!merged.empty() && start <= merged.back().offset + merged.back().size)
+			{
+				VkDeviceSize merged_end = merged.back().offset + merged.back().size;
+				if (end > merged_end) merged.back().size = end - merged.back().offset;
+			}
+			else
+			{
+				merged.push_back({ start, end - start });
+			}
+		}
+		if (merged.size() > m_max_flush_ranges)
+		{
+			merged.front().size = (merged.back().offset + merged.back().size) - merged.front().offset;
+			merged.resize(1);
+		}
+
+		for (auto& range : merged)
+		{
+			VkMappedMemoryRange mapped_range = {};
+			mapped_range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			mapped_range.memory = allocation.memory;
+			mapped_range.offset = allocation.offset + range.offset;
+			mapped_range.size = range.size;
+			// Rounding up can run past the end of our allocation, a dedicated block owns the whole memory so flush to the end
+			if (range.offset + range.size > allocation.size)
+			{
+				mapped_range.size = allocation.block->dedicated ? VK_WHOLE_SIZE : allocation.size - range.offset;
+			}
+			ranges.push_back(mapped_range);
+		}
+		dirty_ranges.clear();
+	}
+}
+
+void Renderer::Vulkan::VulkanBuffer::Invalidate(BufferSlot slot)
+{
+	VulkanAllocation& allocation = m_gpu_allocation[(unsigned int)slot].buffer.allocation;
+	if (allocation.property_flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
 	VkMappedMemoryRange mappedRange = {};
 	mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-	mappedRange.memory = m_gpu_allocation[(unsigned int)slot].buffer.buffer_memory;
-	mappedRange.offset = 0;
-	mappedRange.size = VK_WHOLE_SIZE;
-	VkResult res = vkFlushMappedMemoryRanges(*m_device->GetVulkanDevice(), 1, &mappedRange);
+	mappedRange.memory = allocation.memory;
+	mappedRange.offset = allocation.offset;
+	mappedRange.size = allocation.block->dedicated ? VK_WHOLE_SIZE : allocation.size;
+	vkInvalidateMappedMemoryRanges(*m_device->GetVulkanDevice(), 1, &mappedRange);
+}
+
+void Renderer::Vulkan::VulkanBuffer::StageData(BufferSlot slot, unsigned int startIndex, unsigned int count)
+{
+	VkDeviceSize offset = (VkDeviceSize)startIndex * m_local_allocation[(unsigned int)slot].indexSize;
+	m_device->GetUploadBatch()->Upload(
+		m_gpu_allocation[(unsigned int)slot].buffer.buffer,
+		offset,
+		((char*)m_local_allocation[(unsigned int)slot].dataPtr) + offset,
+		(VkDeviceSize)count * m_local_allocation[(unsigned int)slot].indexSize,
+		&m_gpu_allocation[(unsigned int)slot].graphics_owned
+	);
+}
+
+VkMemoryPropertyFlags Renderer::Vulkan::VulkanBuffer::RequiredMemoryPropertys(BufferUsageHint usage)
+{
+	switch (usage)
+	{
+	case BUFFER_USAGE_STATIC:
+		return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	case BUFFER_USAGE_DYNAMIC:
+	case BUFFER_USAGE_STREAM:
+	case BUFFER_USAGE_READBACK:
+		return VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	}
+	assert(0 && "Unknown buffer usage");
+	return 0;
+}
+
+VkMemoryPropertyFlags Renderer::Vulkan::VulkanBuffer::PreferredMemoryPropertys(BufferUsageHint usage)
+{
+	switch (usage)
+	{
+	case BUFFER_USAGE_STATIC:
+		return 0;
+	case BUFFER_USAGE_DYNAMIC:
+		// ReBAR and unified memory let the CPU write straight into memory the GPU reads quickly
+		return VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	case BUFFER_USAGE_STREAM:
+		return VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	case BUFFER_USAGE_READBACK:
+		return VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+	return 0;
 }
\ No newline at end of file
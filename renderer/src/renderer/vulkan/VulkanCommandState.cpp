@@ -0,0 +1,122 @@
+#include <renderer/vulkan/VulkanCommandState.hpp>
+
+Renderer::Vulkan::VulkanCommandState::VulkanCommandState(VkCommandBuffer command_buffer)
+{
+	m_command_buffer = command_buffer;
+}
+
+VkCommandBuffer & Renderer::Vulkan::VulkanCommandState::GetCommandBuffer()
+{
+	return m_command_buffer;
+}
+
+void Renderer::Vulkan::VulkanCommandState::BindPipeline(VkPipelineBindPoint bind_point, VkPipeline pipeline)
+{
+	VkPipeline& bound = bind_point == VK_PIPELINE_BIND_POINT_COMPUTE ? m_compute_pipeline : m_graphics_pipeline;
+	if (bound == pipeline)
+	{
+		m_skipped_bind_count++;
+		return;
+	}
+	vkCmdBindPipeline(
+		m_command_buffer,
+		bind_point,
+		pipeline
+	);
+	bound = pipeline;
+	m_bind_count++;
+}
+
+void Renderer::Vulkan::VulkanCommandState::BindDescriptorSet(VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t set, VkDescriptorSet descriptor_set)
+{
+	if (layout != m_layout)
+	{
+		m_descriptor_sets.clear();
+		m_layout = layout;
+	}
+	if (set >= m_descriptor_sets.size())
+	{
+		m_descriptor_sets.resize(set + 1);
+	}
+	BoundDescriptorSet& bound = m_descriptor_sets[set];
+	if (bound.bind_point == bind_point && bound.descriptor_set == descriptor_set)
+	{
+		m_skipped_bind_count++;
+		return;
+	}
+	vkCmdBindDescriptorSets(
+		m_command_buffer,
+		bind_point,
+		layout,
+		set,
+		1,
+		&descriptor_set,
+		0,
+		NULL
+	);
+	bound.bind_point = bind_point;
+	bound.descriptor_set = descriptor_set;
+	m_bind_count++;
+}
+
+void Renderer::Vulkan::VulkanCommandState::BindVertexBuffers(uint32_t first_binding, uint32_t count, const VkBuffer * buffers, const VkDeviceSize * offsets)
+{
+	if (first_binding + count > m_vertex_buffers.size())
+	{
+		m_vertex_buffers.resize(first_binding + count);
+	}
+	// Only the run of bindings from the first one that differs to the last one that differs is sent
+	uint32_t first_changed = count;
+	uint32_t last_changed = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		BoundVertexBuffer& bound = m_vertex_buffers[first_binding + i];
+		if (bound.buffer == buffers[i] && bound.offset == offsets[i]) continue;
+		if (first_changed == count) first_changed = i;
+		last_changed = i;
+		bound.buffer = buffers[i];
+		bound.offset = offsets[i];
+	}
+	if (first_changed == count)
+	{
+		m_skipped_bind_count++;
+		return;
+	}
+	vkCmdBindVertexBuffers(
+		m_command_buffer,
+		first_binding + first_changed,
+		last_changed - first_changed + 1,
+		buffers + first_changed,
+		offsets + first_changed
+	);
+	m_bind_count++;
+}
+
+void Renderer::Vulkan::VulkanCommandState::BindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType index_type)
+{
+	if (m_index_buffer == buffer && m_index_offset == offset && m_index_type == index_type)
+	{
+		m_skipped_bind_count++;
+		return;
+	}
+	vkCmdBindIndexBuffer(
+		m_command_buffer,
+		buffer,
+		offset,
+		index_type
+	);
+	m_index_buffer = buffer;
+	m_index_offset = offset;
+	m_index_type = index_type;
+	m_bind_count++;
+}
+
+unsigned int Renderer::Vulkan::VulkanCommandState::GetBindCount()
+{
+	return m_bind_count;
+}
+
+unsigned int Renderer::Vulkan::VulkanCommandState::GetSkippedBindCount()
+{
+	return m_skipped_bind_count;
+}
@@ -2,6 +2,8 @@
 #include <renderer/vulkan/VulkanDevice.hpp>
 #include <renderer/vulkan/VulkanPhysicalDevice.hpp>
 #include <renderer/vulkan/VulkanBufferData.hpp>
+#include <renderer/vulkan/VulkanMemoryAllocator.hpp>
+#include <renderer/vulkan/VulkanUploadBatch.hpp>
 
 #include <fstream>
 
@@ -13,7 +15,7 @@ void VulkanCommon::CreateImageView(VulkanDevice* device, VkImage image, VkFormat
 	vkCreateImageView(
 		*device->GetVulkanDevice(),
 		&create_info,
-		nullptr,
+		device->GetAllocationCallbacks(),
 		&view
 	);
 }
@@ -47,13 +49,13 @@ VkFormat VulkanCommon::FindSupportedFormat(VulkanDevice * device, const std::vec
 	return VK_FORMAT_UNDEFINED;
 }
 
-void VulkanCommon::CreateImage(VulkanDevice* device, VkExtent2D extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VkDeviceMemory & image_memory)
+bool VulkanCommon::CreateImage(VulkanDevice* device, VkExtent2D extent, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VulkanAllocation & image_memory)
 {
 	VkImageCreateInfo create_info = VulkanInitializers::ImageCreateInfo(extent.width, extent.height, format, tiling, usage);
 	vkCreateImage(
 		*device->GetVulkanDevice(),
 		&create_info,
-		nullptr,
+		device->GetAllocationCallbacks(),
 		&image
 	);
 
@@ -64,60 +66,71 @@ void VulkanCommon::CreateImage(VulkanDevice* device, VkExtent2D extent, VkFormat
 		&mem_requirements
 	);
 
-	VkMemoryAllocateInfo alloc_info = VulkanInitializers::MemoryAllocateInfo(mem_requirements.size, FindMemoryType(
-		device->GetVulkanPhysicalDevice(),
-		mem_requirements.memoryTypeBits,
-		properties
-	));
-
-	vkAllocateMemory(
-		*device->GetVulkanDevice(),
-		&alloc_info,
-		nullptr,
-		&image_memory
+	bool allocated = device->GetMemoryAllocator()->Allocate(
+		mem_requirements,
+		properties,
+		0,
+		tiling == VK_IMAGE_TILING_LINEAR,
+		image_memory,
+		GetImageMemoryCategory(usage)
 	);
+	if (!allocated)
+	{
+		vkDestroyImage(
+			*device->GetVulkanDevice(),
+			image,
+			device->GetAllocationCallbacks()
+		);
+		image = VK_NULL_HANDLE;
+		return false;
+	}
 
 	vkBindImageMemory(
 		*device->GetVulkanDevice(),
 		image,
-		image_memory,
-		0
+		image_memory.memory,
+		image_memory.offset
 	);
+	return true;
 }
 
-uint32_t VulkanCommon::FindMemoryType(VulkanPhysicalDevice * device, uint32_t type_filter, VkMemoryPropertyFlags properties)
+uint32_t VulkanCommon::FindMemoryType(VulkanPhysicalDevice * device, uint32_t type_filter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred)
 {
-	for (uint32_t i = 0; i < device->GetPhysicalDeviceMemoryProperties()->memoryTypeCount; i++)
+	VkPhysicalDeviceMemoryProperties* memory_properties = device->GetPhysicalDeviceMemoryProperties();
+	uint32_t best_type = UINT32_MAX;
+	int best_score = -1;
+	for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++)
 	{
-		if (type_filter & (1 << i) &&
-			(device->GetPhysicalDeviceMemoryProperties()->memoryTypes[i].propertyFlags & properties) == properties)
+		VkMemoryPropertyFlags flags = memory_properties->memoryTypes[i].propertyFlags;
+		if (!(type_filter & (1 << i)) || (flags & properties) != properties) continue;
+
+		VkMemoryPropertyFlags matched = flags & preferred;
+		// Host visible device memory only counts as device local when it is backed by a full sized heap (ReBAR or unified memory)
+		// and not the small 256MB window, which we leave for the driver
+		if ((matched & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) && (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+			memory_properties->memoryHeaps[memory_properties->memoryTypes[i].heapIndex].size <= 256 * 1024 * 1024)
 		{
-			return i;
+			matched &= ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		}
+		int score = 0;
+		for (VkMemoryPropertyFlags bit = 1; bit != 0 && bit <= matched; bit <<= 1)
+		{
+			if (matched & bit) score++;
+		}
+		// Types are ordered by the driver from least to most capable, so the first best match wins
+		if (score > best_score)
+		{
+			best_score = score;
+			best_type = i;
 		}
 	}
-	assert(0 && "No available memory properties");
-	return -1;
+	return best_type;
 }
 
 void VulkanCommon::TransitionImageLayout(VulkanDevice* device, VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
 {
-	VkCommandBuffer command_buffer = BeginSingleTimeCommands(device,*device->GetGraphicsCommandPool());
-
-	VkImageMemoryBarrier barrier = VulkanInitializers::ImageMemoryBarrier(image, format, old_layout, new_layout);
-
-	vkCmdPipelineBarrier(
-		command_buffer,
-		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-		0,
-		0,
-		nullptr,
-		0,
-		nullptr,
-		1,
-		&barrier
-	);
-	EndSingleTimeCommands(device,command_buffer, *device->GetGraphicsCommandPool());
+	// Recorded with the rest of the pending uploads and submitted before the next frame
+	device->GetUploadBatch()->TransitionImageLayout(image, format, old_layout, new_layout);
 }
 
 VkCommandBuffer VulkanCommon::BeginSingleTimeCommands(VulkanDevice * device, VkCommandPool command_pool)
@@ -163,16 +176,11 @@ VkCommandBuffer Renderer::Vulkan::VulkanCommon::BeginSimultaneousCommand(VulkanD
 void VulkanCommon::EndSingleTimeCommands(VulkanDevice * device, VkCommandBuffer command_buffer, VkCommandPool command_pool)
 {
 	vkEndCommandBuffer(command_buffer);
-	VkSubmitInfo submit_info = VulkanInitializers::SubmitInfo(command_buffer);
-	vkQueueSubmit(
-		*device->GetGraphicsQueue(),
-		1,
-		&submit_info,
-		VK_NULL_HANDLE
-	);
-	vkQueueWaitIdle(
-		*device->GetGraphicsQueue()
-	);
+	VulkanSubmission submission;
+	submission.command_buffers.push_back(command_buffer);
+	// Wait on this submit alone instead of idling the queue
+	VulkanTimelinePoint point = device->GetGraphicsTimeline()->Submit(submission);
+	device->GetGraphicsTimeline()->Wait(point.value);
 	vkFreeCommandBuffers(
 		*device->GetVulkanDevice(),
 		command_pool,
@@ -186,14 +194,31 @@ bool VulkanCommon::HasStencilComponent(VkFormat format)
 	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-void Renderer::Vulkan::VulkanCommon::CreateBuffer(VulkanDevice * device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VulkanBufferData & buffer)
+Renderer::MemoryCategory Renderer::Vulkan::VulkanCommon::GetBufferMemoryCategory(VkBufferUsageFlags usage)
+{
+	// Uniform buffers are also bound as per instance vertex data, so check the more specific uses first
+	if (usage & VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) return MEMORY_CATEGORY_INDIRECT;
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) return MEMORY_CATEGORY_UNIFORM;
+	if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) return MEMORY_CATEGORY_INDEX;
+	if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) return MEMORY_CATEGORY_VERTEX;
+	if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) return MEMORY_CATEGORY_STAGING;
+	return MEMORY_CATEGORY_OTHER;
+}
+
+Renderer::MemoryCategory Renderer::Vulkan::VulkanCommon::GetImageMemoryCategory(VkImageUsageFlags usage)
+{
+	if (usage & VK_IMAGE_USAGE_SAMPLED_BIT) return MEMORY_CATEGORY_TEXTURE;
+	return MEMORY_CATEGORY_OTHER;
+}
+
+bool Renderer::Vulkan::VulkanCommon::CreateBuffer(VulkanDevice * device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VulkanBufferData & buffer, VkMemoryPropertyFlags preferred)
 {
 	VkBufferCreateInfo buffer_info = VulkanInitializers::BufferCreateInfo(size, usage);
 
 	VkResult a = vkCreateBuffer(
 		*device->GetVulkanDevice(),
 		&buffer_info,
-		nullptr,
+		device->GetAllocationCallbacks(),
 		&buffer.buffer
 	);
 
@@ -205,36 +230,44 @@ void Renderer::Vulkan::VulkanCommon::CreateBuffer(VulkanDevice * device, VkDevic
 	);
 	
 
-	VkMemoryAllocateInfo alloc_info = VulkanInitializers::MemoryAllocateInfo(mem_requirements.size, FindMemoryType(
-		device->GetVulkanPhysicalDevice(),
-		mem_requirements.memoryTypeBits,
-		properties
-	));
 	buffer.size = mem_requirements.size > size ? size : mem_requirements.size;
 	buffer.alignment = mem_requirements.alignment;
-	vkAllocateMemory(
-		*device->GetVulkanDevice(),
-		&alloc_info,
-		nullptr,
-		&buffer.buffer_memory
+	bool allocated = device->GetMemoryAllocator()->Allocate(
+		mem_requirements,
+		properties,
+		preferred,
+		true,
+		buffer.allocation,
+		GetBufferMemoryCategory(usage)
 	);
+	if (!allocated)
+	{
+		vkDestroyBuffer(
+			*device->GetVulkanDevice(),
+			buffer.buffer,
+			device->GetAllocationCallbacks()
+		);
+		buffer.buffer = VK_NULL_HANDLE;
+		return false;
+	}
 
 	vkBindBufferMemory(
 		*device->GetVulkanDevice(),
 		buffer.buffer,
-		buffer.buffer_memory,
-		0
+		buffer.allocation.memory,
+		buffer.allocation.offset
 	);
+	return true;
 }
 
 void Renderer::Vulkan::VulkanCommon::MapBufferMemory(VulkanDevice* device, VulkanBufferData & buffer, VkDeviceSize size)
 {
-	vkMapMemory(*device->GetVulkanDevice(), buffer.buffer_memory, 0, size, 0, &buffer.mapped_memory);
+	// Host visible blocks are persistently mapped by the allocator
+	buffer.mapped_memory = buffer.allocation.mapped_memory;
 }
 
 void Renderer::Vulkan::VulkanCommon::UnMapBufferMemory(VulkanDevice * device, VulkanBufferData & buffer)
 {
-	vkUnmapMemory(*device->GetVulkanDevice(), buffer.buffer_memory);
 	buffer.mapped_memory = nullptr;
 }
 
@@ -244,13 +277,9 @@ void Renderer::Vulkan::VulkanCommon::DestroyBuffer(VulkanDevice * device, Vulkan
 	vkDestroyBuffer(
 		*device->GetVulkanDevice(),
 		buffer.buffer,
-		nullptr
-	);
-	vkFreeMemory(
-		*device->GetVulkanDevice(),
-		buffer.buffer_memory,
-		nullptr
+		device->GetAllocationCallbacks()
 	);
+	device->GetMemoryAllocator()->Free(buffer.allocation);
 }
 
 std::vector<char> Renderer::Vulkan::VulkanCommon::ReadFile(const std::string & filename)
@@ -277,66 +306,18 @@ VkShaderModule Renderer::Vulkan::VulkanCommon::CreateShaderModule(VulkanDevice *
 	vkCreateShaderModule(
 		*device->GetVulkanDevice(),
 		&create_info,
-		nullptr,
+		device->GetAllocationCallbacks(),
 		&shader_module
 	);
 
 	return shader_module;
 }
 
-void Renderer::Vulkan::VulkanCommon::CopyBuffer(VulkanDevice * device, VkBuffer from_buffer, VkBuffer to_buffer, VkDeviceSize size)
+Renderer::UploadHandle Renderer::Vulkan::VulkanCommon::CopyBuffer(VulkanDevice * device, VkBuffer from_buffer, VkBuffer to_buffer, VkDeviceSize size)
 {
-	VkCommandBufferAllocateInfo alloc_info = VulkanInitializers::CommandBufferAllocateInfo(*device->GetGraphicsCommandPool(), 1);
-
-	VkCommandBuffer command_buffer;
-	vkAllocateCommandBuffers(
-		*device->GetVulkanDevice(),
-		&alloc_info,
-		&command_buffer
-	);
-
-	VkCommandBufferBeginInfo begin_info = VulkanInitializers::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-
-	vkBeginCommandBuffer(
-		command_buffer,
-		&begin_info
-	);
-
-	// Copy the temp Ram buffer to the device memory
-	VkBufferCopy copy_region = {};
-	copy_region.srcOffset = 0; // Optional
-	copy_region.dstOffset = 0; // Optional
-	copy_region.size = size;
-	vkCmdCopyBuffer(
-		command_buffer,
-		from_buffer,
-		to_buffer,
-		1,
-		&copy_region
-	);
-	vkEndCommandBuffer(
-		command_buffer
-	);
-	// Now the command has been recorded, submit it
-
-	VkSubmitInfo submit_info = VulkanInitializers::SubmitInfo(command_buffer);
-
-	vkQueueSubmit(
-		*device->GetGraphicsQueue(),
-		1,
-		&submit_info,
-		VK_NULL_HANDLE
-	);
-	vkQueueWaitIdle(
-		*device->GetGraphicsQueue()
-	);
-
-	vkFreeCommandBuffers(
-		*device->GetVulkanDevice(),
-		*device->GetGraphicsCommandPool(),
-		1,
-		&command_buffer
-	);
+	// Recorded after any staged writes already in the pending batch so the copy sees them
+	device->GetUploadBatch()->CopyBuffer(from_buffer, to_buffer, size);
+	return device->SubmitUploads();
 }
 
 void Renderer::Vulkan::VulkanCommon::SetImageLayout(VkCommandBuffer cmdbuffer, VkImage image, VkImageLayout oldImageLayout, VkImageLayout newImageLayout, VkImageSubresourceRange subresourceRange)
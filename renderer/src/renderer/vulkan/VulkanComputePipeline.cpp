@@ -17,24 +17,31 @@ Renderer::Vulkan::VulkanComputePipeline::VulkanComputePipeline(VulkanDevice * de
 
 Renderer::Vulkan::VulkanComputePipeline::~VulkanComputePipeline()
 {
-	vkDestroyPipeline(
-		*m_device->GetVulkanDevice(),
-		m_pipeline,
-		nullptr
-	);
+	VkDevice device = *m_device->GetVulkanDevice();
+	const VkAllocationCallbacks* allocator = m_device->GetAllocationCallbacks();
+	VkPipeline pipeline = m_pipeline;
+	VkPipelineLayout pipeline_layout = m_pipeline_layout;
+	VkShaderModule shader_module = m_shader_module;
+	m_device->DeferDestroy([device, allocator, pipeline, pipeline_layout, shader_module]()
+	{
+		vkDestroyPipeline(
+			device,
+			pipeline,
+			allocator
+		);
 
-	vkDestroyPipelineLayout(
-		*m_device->GetVulkanDevice(),
-		m_pipeline_layout,
-		nullptr
-	);
+		vkDestroyPipelineLayout(
+			device,
+			pipeline_layout,
+			allocator
+		);
 
-	vkDestroyShaderModule(
-		*m_device->GetVulkanDevice(),
-		m_shader_module,
-		nullptr
-	);
-	
+		vkDestroyShaderModule(
+			device,
+			shader_module,
+			allocator
+		);
+	});
 }
 
 bool Renderer::Vulkan::VulkanComputePipeline::Build()
@@ -55,7 +62,7 @@ bool Renderer::Vulkan::VulkanComputePipeline::CreatePipeline()
 	ErrorCheck(vkCreatePipelineLayout(
 		*m_device->GetVulkanDevice(),
 		&pipeline_layout_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_pipeline_layout
 	));
 
@@ -76,7 +83,7 @@ bool Renderer::Vulkan::VulkanComputePipeline::CreatePipeline()
 		0,
 		1,
 		&compute_pipeline_create_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_pipeline
 	));
 
@@ -90,17 +97,17 @@ void Renderer::Vulkan::VulkanComputePipeline::DestroyPipeline()
 	vkDestroyPipelineLayout(
 		*m_device->GetVulkanDevice(),
 		m_pipeline_layout,
-		nullptr
+		m_device->GetAllocationCallbacks()
 	);
 	vkDestroyPipeline(
 		*m_device->GetVulkanDevice(),
 		m_pipeline,
-		nullptr
+		m_device->GetAllocationCallbacks()
 	);
 	vkDestroyShaderModule(
 		*m_device->GetVulkanDevice(),
 		m_shader_module,
-		nullptr
+		m_device->GetAllocationCallbacks()
 	);
 }
 
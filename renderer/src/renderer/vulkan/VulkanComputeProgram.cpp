@@ -7,14 +7,10 @@
 Renderer::Vulkan::VulkanComputeProgram::VulkanComputeProgram(VulkanDevice * device)
 {
 	m_device = device;
-
-	VkFenceCreateInfo fenceCreateInfo = VulkanInitializers::CreateFenceInfo();
-	ErrorCheck(vkCreateFence(*device->GetVulkanDevice(), &fenceCreateInfo, NULL, &m_fence));
 }
 
 Renderer::Vulkan::VulkanComputeProgram::~VulkanComputeProgram()
 {
-	vkDestroyFence(*m_device->GetVulkanDevice(), m_fence, NULL);
 	vkFreeCommandBuffers(
 		*m_device->GetVulkanDevice(),
 		*m_device->GetComputeCommandPool(),
@@ -41,15 +37,21 @@ void Renderer::Vulkan::VulkanComputeProgram::Build()
 
 void Renderer::Vulkan::VulkanComputeProgram::Run()
 {
-	VkSubmitInfo submitInfo = VulkanInitializers::SubmitInfo(m_command_buffer);
-
-	ErrorCheck(vkQueueSubmit(*m_device->GetComputeQueue(), 1, &submitInfo, m_fence));
-	assert(!HasError() && "Unable to submit queue");
-	ErrorCheck(vkWaitForFences(*m_device->GetVulkanDevice(), 1, &m_fence, VK_TRUE, LONG_MAX));
-	assert(!HasError() && "Unable to wait for fence");
-	vkResetFences(
-		*m_device->GetVulkanDevice(),
-		1,
-		&m_fence
-	);
+	// The results may feed the next frame
+	m_device->MarkSceneChanged();
+	m_device->FlushMappedRanges();
+	m_device->SubmitUploads();
+	VulkanSubmission submission;
+	submission.command_buffers.push_back(m_command_buffer);
+	// Wait for pending uploads on the GPU rather than the CPU
+	submission.wait_points.push_back(m_device->GetUploadPoint());
+	submission.wait_point_stages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	// Frames still in flight may be reading the buffers this program writes
+	VulkanTimelinePoint graphics_point;
+	graphics_point.timeline = m_device->GetGraphicsTimeline();
+	graphics_point.value = graphics_point.timeline->GetSubmittedValue();
+	submission.wait_points.push_back(graphics_point);
+	submission.wait_point_stages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	VulkanTimelinePoint point = m_device->GetComputeTimeline()->Submit(submission);
+	m_device->GetComputeTimeline()->Wait(point.value);
 }
@@ -5,6 +5,7 @@
 #include <renderer/vulkan/VulkanDescriptorSet.hpp>
 
 #include <assert.h>
+#include <algorithm>
 
 using namespace Renderer;
 using namespace Renderer::Vulkan;
@@ -29,12 +30,12 @@ Renderer::Vulkan::VulkanDescriptorPool::VulkanDescriptorPool(VulkanDevice * devi
 	}
 
 
-	VkDescriptorPoolCreateInfo create_info = VulkanInitializers::DescriptorPoolCreateInfo(m_descriptor_pool_sizes, 20);
+	VkDescriptorPoolCreateInfo create_info = VulkanInitializers::DescriptorPoolCreateInfo(m_descriptor_pool_sizes, 20, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
 
 	ErrorCheck(vkCreateDescriptorPool(
 		*m_device->GetVulkanDevice(),
 		&create_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_descriptor_pool
 	));
 
@@ -45,7 +46,7 @@ Renderer::Vulkan::VulkanDescriptorPool::VulkanDescriptorPool(VulkanDevice * devi
 	ErrorCheck(vkCreateDescriptorSetLayout(
 		*m_device->GetVulkanDevice(),
 		&layout_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_descriptor_set_layout
 	));
 
@@ -58,16 +59,28 @@ Renderer::Vulkan::VulkanDescriptorPool::~VulkanDescriptorPool()
 	{
 		delete m_descriptor[i];
 	}
-	vkDestroyDescriptorSetLayout(
-		*m_device->GetVulkanDevice(),
-		m_descriptor_set_layout,
-		nullptr
-	);
-	vkDestroyDescriptorPool(
-		*m_device->GetVulkanDevice(),
-		m_descriptor_pool,
-		nullptr
-	);
+	// Destroying the pool frees every set still allocated from it
+	for (auto descriptor_set : m_descriptor_sets)
+	{
+		descriptor_set->DetachPool();
+	}
+	VkDevice device = *m_device->GetVulkanDevice();
+	const VkAllocationCallbacks* allocator = m_device->GetAllocationCallbacks();
+	VkDescriptorSetLayout descriptor_set_layout = m_descriptor_set_layout;
+	VkDescriptorPool descriptor_pool = m_descriptor_pool;
+	m_device->DeferDestroy([device, allocator, descriptor_set_layout, descriptor_pool]()
+	{
+		vkDestroyDescriptorSetLayout(
+			device,
+			descriptor_set_layout,
+			allocator
+		);
+		vkDestroyDescriptorPool(
+			device,
+			descriptor_pool,
+			allocator
+		);
+	});
 
 }
 
@@ -98,5 +111,24 @@ IDescriptorSet * Renderer::Vulkan::VulkanDescriptorPool::CreateDescriptorSet()
 		&descriptor_set
 	));
 	if (HasError())assert(0 && "Unable To Create Descriptor Set");
-	return new VulkanDescriptorSet(m_device, this, descriptor_set);
+	VulkanDescriptorSet* vulkan_descriptor_set = new VulkanDescriptorSet(m_device, this, descriptor_set);
+	m_descriptor_sets.push_back(vulkan_descriptor_set);
+	return vulkan_descriptor_set;
+}
+
+void Renderer::Vulkan::VulkanDescriptorPool::FreeDescriptorSet(VulkanDescriptorSet * descriptor_set)
+{
+	m_descriptor_sets.erase(std::remove(m_descriptor_sets.begin(), m_descriptor_sets.end(), descriptor_set), m_descriptor_sets.end());
+	VkDevice device = *m_device->GetVulkanDevice();
+	VkDescriptorPool descriptor_pool = m_descriptor_pool;
+	VkDescriptorSet set = descriptor_set->GetDescriptorSet();
+	m_device->DeferDestroy([device, descriptor_pool, set]()
+	{
+		vkFreeDescriptorSets(
+			device,
+			descriptor_pool,
+			1,
+			&set
+		);
+	});
 }
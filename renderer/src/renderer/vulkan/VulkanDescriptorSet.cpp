@@ -14,6 +14,14 @@ Renderer::Vulkan::VulkanDescriptorSet::VulkanDescriptorSet(VulkanDevice* device,
 	m_descriptor_set = set;
 }
 
+Renderer::Vulkan::VulkanDescriptorSet::~VulkanDescriptorSet()
+{
+	if (m_descriptor_pool != nullptr)
+	{
+		m_descriptor_pool->FreeDescriptorSet(this);
+	}
+}
+
 VkDescriptorSet & Renderer::Vulkan::VulkanDescriptorSet::GetDescriptorSet()
 {
 	return m_descriptor_set;
@@ -40,6 +48,7 @@ void Renderer::Vulkan::VulkanDescriptorSet::UpdateSet()
 		}
 	}
 	vkUpdateDescriptorSets(*m_device->GetVulkanDevice(), (uint32_t)m_write_descriptor_sets.size(), m_write_descriptor_sets.data(), 0, NULL);
+	m_device->MarkSceneChanged();
 }
 
 void Renderer::Vulkan::VulkanDescriptorSet::AttachBuffer(unsigned int location, IBuffer * buffer)
@@ -61,3 +70,8 @@ bool Renderer::Vulkan::VulkanDescriptorSet::HasBufferAtLocation(unsigned int loc
 {
 	return m_bufers.find(location) != m_bufers.end();
 }
+
+void Renderer::Vulkan::VulkanDescriptorSet::DetachPool()
+{
+	m_descriptor_pool = nullptr;
+}
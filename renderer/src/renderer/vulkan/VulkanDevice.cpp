@@ -2,8 +2,13 @@
 #include <renderer/vulkan/VulkanPhysicalDevice.hpp>
 #include <renderer/vulkan/VulkanInstance.hpp>
 #include <renderer/vulkan/VulkanInitializers.hpp>
+#include <renderer/vulkan/VulkanMemoryAllocator.hpp>
+#include <renderer/vulkan/VulkanStagingRing.hpp>
+#include <renderer/vulkan/VulkanBuffer.hpp>
+#include <renderer/vulkan/VulkanUploadBatch.hpp>
 
 #include <assert.h>
+#include <algorithm>
 
 Renderer::Vulkan::VulkanDevice::VulkanDevice(VulkanInstance * instance, VulkanPhysicalDevice * physical_device)
 {
@@ -12,9 +17,17 @@ Renderer::Vulkan::VulkanDevice::VulkanDevice(VulkanInstance * instance, VulkanPh
 
 	std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
 
+	VulkanQueueFamilyIndices* queue_families = m_physical_device->GetQueueFamilies();
 	std::vector<uint32_t> unique_queue_families;
-	unique_queue_families.push_back(m_physical_device->GetQueueFamilies()->graphics_indices);
-	//unique_queue_families.push_back(m_physical_device->GetQueueFamilies()->compute_indices);
+	unique_queue_families.push_back(queue_families->graphics_indices);
+	if (queue_families->present_indices != queue_families->graphics_indices)
+	{
+		unique_queue_families.push_back(queue_families->present_indices);
+	}
+	if (HasDedicatedTransferQueue())
+	{
+		unique_queue_families.push_back(queue_families->transfer_indices);
+	}
 
 
 	for (auto queue_family : unique_queue_families)
@@ -27,15 +40,40 @@ Renderer::Vulkan::VulkanDevice::VulkanDevice(VulkanInstance * instance, VulkanPh
 		*m_physical_device->GetExtenstions(),
 		*m_physical_device->GetDeviceFeatures()
 	);
+#ifdef VK_KHR_timeline_semaphore
+	// Devices that expose the extension have to support the feature, it just needs turning on
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timeline_features = {};
+	timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timeline_features.timelineSemaphore = VK_TRUE;
+	if (m_physical_device->HasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+	{
+		create_info.pNext = &timeline_features;
+	}
+#endif
 	// Create the device
 	ErrorCheck(vkCreateDevice(
 		*m_physical_device->GetPhysicalDevice(),
 		&create_info,
-		nullptr,
+		GetAllocationCallbacks(),
 		&m_device
 	));
 	assert(!HasError() && "Unable up create vulkan device");
 
+	m_memory_allocator = new VulkanMemoryAllocator(this);
+#ifdef VK_EXT_memory_budget
+	if (m_physical_device->HasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+	{
+		m_get_memory_properties2 = (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(*m_instance->GetInstance(), "vkGetPhysicalDeviceMemoryProperties2KHR");
+	}
+#endif
+#ifdef VK_KHR_draw_indirect_count
+	if (m_physical_device->HasExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME))
+	{
+		m_draw_indirect_count = (PFN_vkCmdDrawIndirectCountKHR)vkGetDeviceProcAddr(m_device, "vkCmdDrawIndirectCountKHR");
+		m_draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(m_device, "vkCmdDrawIndexedIndirectCountKHR");
+	}
+#endif
+
 	vkGetDeviceQueue(
 		m_device,
 		m_physical_device->GetQueueFamilies()->compute_indices,
@@ -50,16 +88,25 @@ Renderer::Vulkan::VulkanDevice::VulkanDevice(VulkanInstance * instance, VulkanPh
 	);
 	vkGetDeviceQueue(
 		m_device,
-		m_physical_device->GetQueueFamilies()->graphics_indices,
+		m_physical_device->GetQueueFamilies()->present_indices,
 		0,
 		&m_present_queue
 	);
+	vkGetDeviceQueue(
+		m_device,
+		m_physical_device->GetQueueFamilies()->transfer_indices,
+		0,
+		&m_transfer_queue
+	);
+	m_graphics_timeline = new VulkanTimeline(this, m_graphics_queue);
+	m_compute_timeline = m_compute_queue == m_graphics_queue ? m_graphics_timeline : new VulkanTimeline(this, m_compute_queue);
+	m_transfer_timeline = m_transfer_queue == m_graphics_queue ? m_graphics_timeline : new VulkanTimeline(this, m_transfer_queue);
 	// Setup command pools
 	VkCommandPoolCreateInfo compute_pool_info = VulkanInitializers::CommandPoolCreateInfo(m_physical_device->GetQueueFamilies()->compute_indices);
 	ErrorCheck(vkCreateCommandPool(
 		m_device,
 		&compute_pool_info,
-		nullptr,
+		GetAllocationCallbacks(),
 		&m_compute_command_pool
 	));
 
@@ -69,31 +116,76 @@ Renderer::Vulkan::VulkanDevice::VulkanDevice(VulkanInstance * instance, VulkanPh
 	ErrorCheck(vkCreateCommandPool(
 		m_device,
 		&graphics_pool_info,
-		nullptr,
+		GetAllocationCallbacks(),
 		&m_graphics_command_pool
 	));
 
 	assert(!HasError() && "Unable to create graphics command pool");
 
+	if (HasDedicatedTransferQueue())
+	{
+		VkCommandPoolCreateInfo transfer_pool_info = VulkanInitializers::CommandPoolCreateInfo(m_physical_device->GetQueueFamilies()->transfer_indices, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		ErrorCheck(vkCreateCommandPool(
+			m_device,
+			&transfer_pool_info,
+			GetAllocationCallbacks(),
+			&m_transfer_command_pool
+		));
+		assert(!HasError() && "Unable to create transfer command pool");
+	}
+	else
+	{
+		// Uploads are recorded into graphics command buffers
+		m_transfer_command_pool = m_graphics_command_pool;
+	}
+
+	// Start with 8MB of staging space, the ring will grow if a single upload needs more
+	m_staging_ring = new VulkanStagingRing(this, 8 * 1024 * 1024);
 }
 
 Renderer::Vulkan::VulkanDevice::~VulkanDevice()
 {
+	delete m_upload_batch;
+	m_upload_batch = nullptr;
+	while (RetireUpload(true));
+	// Destruction tagged with the discarded batch has nothing left to wait for
+	m_completed_upload_handle = m_next_upload_handle;
+	// Everything has finished on the GPU so all deferred destruction runs here
+	RetireFrames(true);
+	if (m_transfer_timeline != m_graphics_timeline) delete m_transfer_timeline;
+	if (m_compute_timeline != m_graphics_timeline) delete m_compute_timeline;
+	delete m_graphics_timeline;
+	m_graphics_timeline = nullptr;
+	m_compute_timeline = nullptr;
+	m_transfer_timeline = nullptr;
+	delete m_staging_ring;
+	m_staging_ring = nullptr;
 	vkDestroyCommandPool(
 		m_device,
 		m_graphics_command_pool,
-		nullptr
+		GetAllocationCallbacks()
 	);
 	m_graphics_command_pool = VK_NULL_HANDLE;
 	vkDestroyCommandPool(
 		m_device,
 		m_compute_command_pool,
-		nullptr
+		GetAllocationCallbacks()
 	);
 	m_compute_command_pool = VK_NULL_HANDLE;
+	if (HasDedicatedTransferQueue())
+	{
+		vkDestroyCommandPool(
+			m_device,
+			m_transfer_command_pool,
+			GetAllocationCallbacks()
+		);
+	}
+	m_transfer_command_pool = VK_NULL_HANDLE;
+	delete m_memory_allocator;
+	m_memory_allocator = nullptr;
 	vkDestroyDevice(
 		m_device,
-		nullptr
+		GetAllocationCallbacks()
 	);
 	m_device = VK_NULL_HANDLE;
 }
@@ -108,6 +200,11 @@ Renderer::Vulkan::VulkanPhysicalDevice * Renderer::Vulkan::VulkanDevice::GetVulk
 	return m_physical_device;
 }
 
+const VkAllocationCallbacks * Renderer::Vulkan::VulkanDevice::GetAllocationCallbacks()
+{
+	return m_instance->GetAllocationCallbacks();
+}
+
 VkQueue * Renderer::Vulkan::VulkanDevice::GetGraphicsQueue()
 {
 	return &m_graphics_queue;
@@ -123,6 +220,31 @@ VkQueue * Renderer::Vulkan::VulkanDevice::GetComputeQueue()
 	return &m_compute_queue;
 }
 
+VkQueue * Renderer::Vulkan::VulkanDevice::GetTransferQueue()
+{
+	return &m_transfer_queue;
+}
+
+bool Renderer::Vulkan::VulkanDevice::HasDedicatedTransferQueue()
+{
+	return m_physical_device->GetQueueFamilies()->transfer_indices != m_physical_device->GetQueueFamilies()->graphics_indices;
+}
+
+Renderer::Vulkan::VulkanTimeline * Renderer::Vulkan::VulkanDevice::GetGraphicsTimeline()
+{
+	return m_graphics_timeline;
+}
+
+Renderer::Vulkan::VulkanTimeline * Renderer::Vulkan::VulkanDevice::GetComputeTimeline()
+{
+	return m_compute_timeline;
+}
+
+Renderer::Vulkan::VulkanTimeline * Renderer::Vulkan::VulkanDevice::GetTransferTimeline()
+{
+	return m_transfer_timeline;
+}
+
 VkCommandPool * Renderer::Vulkan::VulkanDevice::GetGraphicsCommandPool()
 {
 	return &m_graphics_command_pool;
@@ -133,6 +255,282 @@ VkCommandPool * Renderer::Vulkan::VulkanDevice::GetComputeCommandPool()
 	return &m_compute_command_pool;
 }
 
+VkCommandPool * Renderer::Vulkan::VulkanDevice::GetTransferCommandPool()
+{
+	return &m_transfer_command_pool;
+}
+
+Renderer::Vulkan::VulkanMemoryAllocator * Renderer::Vulkan::VulkanDevice::GetMemoryAllocator()
+{
+	return m_memory_allocator;
+}
+
+Renderer::Vulkan::VulkanStagingRing * Renderer::Vulkan::VulkanDevice::GetStagingRing()
+{
+	return m_staging_ring;
+}
+
+void Renderer::Vulkan::VulkanDevice::GetMemoryStats(MemoryStats & stats)
+{
+	m_memory_allocator->GetMemoryStats(stats);
+	stats.has_budget = false;
+#ifdef VK_EXT_memory_budget
+	if (m_get_memory_properties2 == nullptr) return;
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {};
+	budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	VkPhysicalDeviceMemoryProperties2KHR memory_properties = {};
+	memory_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+	memory_properties.pNext = &budget_properties;
+	m_get_memory_properties2(*m_physical_device->GetPhysicalDevice(), &memory_properties);
+	for (uint32_t i = 0; i < stats.heaps.size(); i++)
+	{
+		stats.heaps[i].budget = budget_properties.heapBudget[i];
+		stats.heaps[i].usage = budget_properties.heapUsage[i];
+	}
+	stats.has_budget = true;
+#endif
+}
+
+void Renderer::Vulkan::VulkanDevice::RegisterDirtyBuffer(VulkanBuffer * buffer)
+{
+	m_dirty_buffers.push_back(buffer);
+}
+
+void Renderer::Vulkan::VulkanDevice::UnregisterBuffer(VulkanBuffer * buffer)
+{
+	m_dirty_buffers.erase(std::remove(m_dirty_buffers.begin(), m_dirty_buffers.end(), buffer), m_dirty_buffers.end());
+}
+
+bool Renderer::Vulkan::VulkanDevice::CanDrawIndirectCount(uint32_t max_draw_count)
+{
+#ifdef VK_KHR_draw_indirect_count
+	return m_draw_indirect_count != nullptr &&
+		m_physical_device->GetDeviceFeatures()->multiDrawIndirect &&
+		m_physical_device->GetPhysicalDeviceProperties()->limits.maxDrawIndirectCount >= max_draw_count;
+#else
+	return false;
+#endif
+}
+
+void Renderer::Vulkan::VulkanDevice::CmdDrawIndirectCount(VkCommandBuffer command_buffer, bool indexed, VkBuffer buffer, VkBuffer count_buffer, uint32_t max_draw_count, uint32_t stride)
+{
+#ifdef VK_KHR_draw_indirect_count
+	if (indexed)
+	{
+		m_draw_indexed_indirect_count(command_buffer, buffer, 0, count_buffer, 0, max_draw_count, stride);
+	}
+	else
+	{
+		m_draw_indirect_count(command_buffer, buffer, 0, count_buffer, 0, max_draw_count, stride);
+	}
+#else
+	assert(0 && "Indirect count draws need VK_KHR_draw_indirect_count");
+#endif
+}
+
+void Renderer::Vulkan::VulkanDevice::AddCommandStats(unsigned int binds, unsigned int skipped_binds)
+{
+	m_bind_count += binds;
+	m_skipped_bind_count += skipped_binds;
+}
+
+void Renderer::Vulkan::VulkanDevice::GetCommandStats(CommandStats & stats)
+{
+	stats.binds = m_bind_count;
+	stats.skipped_binds = m_skipped_bind_count;
+}
+
+void Renderer::Vulkan::VulkanDevice::MarkSceneChanged()
+{
+	m_scene_changed = true;
+}
+
+bool Renderer::Vulkan::VulkanDevice::CheckSceneChanged()
+{
+	bool changed = m_scene_changed;
+	m_scene_changed = false;
+	return changed;
+}
+
+void Renderer::Vulkan::VulkanDevice::RegisterLateLatch(VulkanUniformBuffer * buffer)
+{
+	m_late_latches.push_back(buffer);
+}
+
+void Renderer::Vulkan::VulkanDevice::UnregisterLateLatch(VulkanUniformBuffer * buffer)
+{
+	m_late_latches.erase(std::remove(m_late_latches.begin(), m_late_latches.end(), buffer), m_late_latches.end());
+}
+
+const std::vector<Renderer::Vulkan::VulkanUniformBuffer*>& Renderer::Vulkan::VulkanDevice::GetLateLatches()
+{
+	return m_late_latches;
+}
+
+void Renderer::Vulkan::VulkanDevice::FlushMappedRanges()
+{
+	if (m_dirty_buffers.empty()) return;
+	VkDeviceSize atom_size = m_physical_device->GetPhysicalDeviceProperties()->limits.nonCoherentAtomSize;
+	for (auto buffer : m_dirty_buffers)
+	{
+		buffer->CollectFlushRanges(m_flush_ranges, atom_size);
+	}
+	m_dirty_buffers.clear();
+	if (m_flush_ranges.empty()) return;
+	ErrorCheck(vkFlushMappedMemoryRanges(
+		m_device,
+		(uint32_t)m_flush_ranges.size(),
+		m_flush_ranges.data()
+	));
+	assert(!HasError() && "Unable to flush mapped memory");
+	m_flush_ranges.clear();
+}
+
+Renderer::Vulkan::VulkanUploadBatch * Renderer::Vulkan::VulkanDevice::GetUploadBatch()
+{
+	if (m_upload_batch == nullptr)
+	{
+		m_upload_batch = new VulkanUploadBatch(this);
+	}
+	return m_upload_batch;
+}
+
+Renderer::UploadHandle Renderer::Vulkan::VulkanDevice::SubmitUploads()
+{
+	// Clear out anything that has finished so the ring space can be reused
+	while (!m_submitted_uploads.empty() && m_submitted_uploads.front()->IsComplete())
+	{
+		RetireUpload(false);
+	}
+	if (m_upload_batch == nullptr) return m_next_upload_handle - 1;
+	VulkanUploadBatch* batch = m_upload_batch;
+	m_upload_batch = nullptr;
+	return SubmitUploadBatch(batch);
+}
+
+Renderer::UploadHandle Renderer::Vulkan::VulkanDevice::GetPendingUploadHandle()
+{
+	if (m_upload_batch == nullptr || !m_upload_batch->HasCommands()) return m_next_upload_handle - 1;
+	return m_next_upload_handle;
+}
+
+Renderer::UploadHandle Renderer::Vulkan::VulkanDevice::SubmitUploadBatch(VulkanUploadBatch * batch)
+{
+	if (!batch->HasCommands())
+	{
+		delete batch;
+		return m_next_upload_handle - 1;
+	}
+	// Host writes that the copies read from have to land first
+	FlushMappedRanges();
+	MarkSceneChanged();
+	UploadHandle handle = m_next_upload_handle++;
+	batch->Submit(handle);
+	m_submitted_uploads.push_back(batch);
+	return handle;
+}
+
+bool Renderer::Vulkan::VulkanDevice::IsUploadComplete(UploadHandle handle)
+{
+	while (!m_submitted_uploads.empty() && m_submitted_uploads.front()->IsComplete())
+	{
+		RetireUpload(false);
+	}
+	return handle <= m_completed_upload_handle;
+}
+
+void Renderer::Vulkan::VulkanDevice::WaitForUpload(UploadHandle handle)
+{
+	while (handle > m_completed_upload_handle && RetireUpload(true));
+}
+
+Renderer::Vulkan::VulkanTimelinePoint Renderer::Vulkan::VulkanDevice::GetUploadPoint()
+{
+	if (m_submitted_uploads.empty()) return VulkanTimelinePoint();
+	return m_submitted_uploads.back()->GetPoint();
+}
+
+bool Renderer::Vulkan::VulkanDevice::RetireUpload(bool wait)
+{
+	if (m_submitted_uploads.empty()) return false;
+	VulkanUploadBatch* batch = m_submitted_uploads.front();
+	if (!wait && !batch->IsComplete()) return false;
+	// Batches execute in submission order so everything up to this handle is complete
+	m_completed_upload_handle = batch->GetHandle();
+	m_submitted_uploads.pop_front();
+	delete batch;
+	return true;
+}
+
+uint64_t Renderer::Vulkan::VulkanDevice::SubmitFrame(const VulkanSubmission & submission)
+{
+	VulkanTimelinePoint point = m_graphics_timeline->Submit(submission);
+	m_frames_in_flight.push_back({ ++m_frame_serial, point.value });
+	return m_frame_serial;
+}
+
+uint64_t Renderer::Vulkan::VulkanDevice::GetFrameSerial()
+{
+	return m_frame_serial;
+}
+
+void Renderer::Vulkan::VulkanDevice::WaitForFrame(uint64_t serial)
+{
+	// Frames finish in submission order, so waiting on this frame covers every earlier frame too
+	for (auto& frame : m_frames_in_flight)
+	{
+		if (frame.serial > serial) break;
+		if (frame.serial == serial)
+		{
+			m_graphics_timeline->Wait(frame.value);
+			break;
+		}
+	}
+	RetireFrames();
+}
+
+void Renderer::Vulkan::VulkanDevice::RetireFrames(bool wait)
+{
+	while (!m_frames_in_flight.empty())
+	{
+		FrameSubmit& frame = m_frames_in_flight.front();
+		if (wait)
+		{
+			m_graphics_timeline->Wait(frame.value);
+		}
+		else if (!m_graphics_timeline->IsComplete(frame.value))
+		{
+			break;
+		}
+		m_completed_frame = frame.serial;
+		m_frames_in_flight.pop_front();
+	}
+	while (!m_submitted_uploads.empty() && m_submitted_uploads.front()->IsComplete())
+	{
+		RetireUpload(false);
+	}
+	// Frame serials and upload handles only ever grow, so stop at the first entry that is still in use
+	while (!m_deferred_destroys.empty())
+	{
+		DeferredDestroy& deferred = m_deferred_destroys.front();
+		if (deferred.frame > m_completed_frame || deferred.upload > m_completed_upload_handle) break;
+		deferred.destroy();
+		m_deferred_destroys.pop_front();
+	}
+}
+
+void Renderer::Vulkan::VulkanDevice::DeferDestroy(std::function<void()> destroy)
+{
+	// Copies into the resource may still be sitting in the pending batch, wait on the handle it will get rather than submitting it early
+	UploadHandle upload = GetPendingUploadHandle();
+	if (m_deferred_destroys.empty() && m_frame_serial == m_completed_frame && upload <= m_completed_upload_handle)
+	{
+		destroy();
+		return;
+	}
+	m_deferred_destroys.push_back({ m_frame_serial, upload, destroy });
+}
+
 void Renderer::Vulkan::VulkanDevice::GetGraphicsCommand(VkCommandBuffer * buffers, uint32_t count)
 {
 	VkCommandBufferAllocateInfo command_buffer_allocate_info = VulkanInitializers::CommandBufferAllocateInfo(*GetGraphicsCommandPool(), count);
@@ -155,9 +553,11 @@ void Renderer::Vulkan::VulkanDevice::GetGraphicsCommand(VkCommandBuffer * buffer
 
 void Renderer::Vulkan::VulkanDevice::SubmitGraphicsCommand(VkCommandBuffer * buffers, uint32_t count)
 {
-	VkSubmitInfo submit_info = VulkanInitializers::SubmitInfo(buffers, count);
-	ErrorCheck(vkQueueSubmit(m_graphics_queue, 1, &submit_info, VK_NULL_HANDLE));
-	ErrorCheck(vkQueueWaitIdle(m_graphics_queue));
+	VulkanSubmission submission;
+	submission.command_buffers.assign(buffers, buffers + count);
+	// Only wait on our own work rather than idling the whole queue
+	VulkanTimelinePoint point = m_graphics_timeline->Submit(submission);
+	m_graphics_timeline->Wait(point.value);
 }
 
 void Renderer::Vulkan::VulkanDevice::FreeGraphicsCommand(VkCommandBuffer * buffers, uint32_t count)
@@ -168,3 +568,22 @@ void Renderer::Vulkan::VulkanDevice::FreeGraphicsCommand(VkCommandBuffer * buffe
 		count,
 		buffers);
 }
+
+void Renderer::Vulkan::VulkanDevice::GetTransferCommand(VkCommandBuffer * buffers, uint32_t count)
+{
+	VkCommandBufferAllocateInfo command_buffer_allocate_info = VulkanInitializers::CommandBufferAllocateInfo(*GetTransferCommandPool(), count);
+	ErrorCheck(vkAllocateCommandBuffers(
+		*GetVulkanDevice(),
+		&command_buffer_allocate_info,
+		buffers
+	));
+}
+
+void Renderer::Vulkan::VulkanDevice::FreeTransferCommand(VkCommandBuffer * buffers, uint32_t count)
+{
+	vkFreeCommandBuffers(
+		*GetVulkanDevice(),
+		*GetTransferCommandPool(),
+		count,
+		buffers);
+}
@@ -0,0 +1,150 @@
+#include <renderer/vulkan/VulkanGeometryArena.hpp>
+#include <renderer/vulkan/VulkanDevice.hpp>
+#include <renderer/vulkan/VulkanVertexBuffer.hpp>
+#include <renderer/vulkan/VulkanIndexBuffer.hpp>
+#include <renderer/vulkan/VulkanUniformBuffer.hpp>
+#include <renderer/IModel.hpp>
+
+#include <assert.h>
+
+Renderer::Vulkan::VulkanGeometryArena::VulkanGeometryArena(VulkanDevice * device, unsigned int vertex_size, unsigned int vertex_capacity, unsigned int index_capacity, unsigned int instance_capacity)
+{
+	m_device = device;
+	m_vertex_size = vertex_size;
+	m_instance_capacity = instance_capacity;
+	// Vulkan buffers can not be empty, so non indexed arenas still get a single index
+	if (index_capacity == 0) index_capacity = 1;
+	m_vertex_data.resize(vertex_size * vertex_capacity);
+	m_index_data.resize(index_capacity);
+	m_vertex_buffer = new VulkanVertexBuffer(m_device, m_vertex_data.data(), vertex_size, vertex_capacity, BUFFER_USAGE_STATIC);
+	m_index_buffer = new VulkanIndexBuffer(m_device, m_index_data.data(), sizeof(unsigned short), index_capacity, BUFFER_USAGE_STATIC);
+	m_free_lists = std::make_shared<FreeLists>();
+	m_free_lists->vertices.push_back({ 0, vertex_capacity });
+	m_free_lists->indices.push_back({ 0, index_capacity });
+	if (instance_capacity > 0)
+	{
+		m_free_lists->instances.push_back({ 0, instance_capacity });
+	}
+}
+
+Renderer::Vulkan::VulkanGeometryArena::~VulkanGeometryArena()
+{
+	// Deferred mesh releases share the free lists, so they can still run after this
+	delete m_vertex_buffer;
+	delete m_index_buffer;
+}
+
+Renderer::MeshRange Renderer::Vulkan::VulkanGeometryArena::AddMesh(void * vertices, unsigned int vertex_count, unsigned short * indices, unsigned int index_count)
+{
+	MeshRange mesh;
+	if (vertex_count == 0 || !AllocateRange(m_free_lists->vertices, vertex_count, mesh.first_vertex))
+	{
+		return MeshRange();
+	}
+	if (index_count > 0 && !AllocateRange(m_free_lists->indices, index_count, mesh.first_index))
+	{
+		ReleaseRange(m_free_lists->vertices, mesh.first_vertex, vertex_count);
+		return MeshRange();
+	}
+	mesh.vertex_count = vertex_count;
+	mesh.index_count = index_count;
+
+	memcpy(m_vertex_data.data() + (size_t)mesh.first_vertex * m_vertex_size, vertices, (size_t)vertex_count * m_vertex_size);
+	m_vertex_buffer->SetData(BufferSlot::Primary, mesh.first_vertex, vertex_count);
+	if (index_count > 0)
+	{
+		memcpy(m_index_data.data() + mesh.first_index, indices, index_count * sizeof(unsigned short));
+		m_index_buffer->SetData(BufferSlot::Primary, mesh.first_index, index_count);
+	}
+	return mesh;
+}
+
+void Renderer::Vulkan::VulkanGeometryArena::RemoveMesh(MeshRange mesh)
+{
+	if (mesh.vertex_count == 0) return;
+	// Frames in flight may still be reading the mesh, so the space is only reused once they are done
+	std::shared_ptr<FreeLists> free_lists = m_free_lists;
+	m_device->DeferDestroy([free_lists, mesh]()
+	{
+		ReleaseRange(free_lists->vertices, mesh.first_vertex, mesh.vertex_count);
+		if (mesh.index_count > 0)
+		{
+			ReleaseRange(free_lists->indices, mesh.first_index, mesh.index_count);
+		}
+	});
+}
+
+Renderer::IVertexBuffer * Renderer::Vulkan::VulkanGeometryArena::GetVertexBuffer()
+{
+	return m_vertex_buffer;
+}
+
+Renderer::IIndexBuffer * Renderer::Vulkan::VulkanGeometryArena::GetIndexBuffer()
+{
+	return m_index_buffer;
+}
+
+void Renderer::Vulkan::VulkanGeometryArena::AttachBuffer(unsigned int index, IUniformBuffer * buffer)
+{
+	assert(index < IModel::MAX_MODEL_BUFFERS && "Model buffer index out of range");
+	assert(buffer->GetElementCount(BufferSlot::Primary) >= m_instance_capacity && "Instance buffer is smaller than the arena instance capacity");
+	m_buffers[index] = dynamic_cast<VulkanUniformBuffer*>(buffer);
+}
+
+std::map<unsigned int, Renderer::Vulkan::VulkanUniformBuffer*>& Renderer::Vulkan::VulkanGeometryArena::GetBuffers()
+{
+	return m_buffers;
+}
+
+bool Renderer::Vulkan::VulkanGeometryArena::AllocateInstances(unsigned int count, unsigned int & first)
+{
+	return AllocateRange(m_free_lists->instances, count, first);
+}
+
+void Renderer::Vulkan::VulkanGeometryArena::ReleaseInstances(unsigned int first, unsigned int count)
+{
+	if (count == 0) return;
+	// Frames in flight may still be reading the old instance data
+	std::shared_ptr<FreeLists> free_lists = m_free_lists;
+	m_device->DeferDestroy([free_lists, first, count]()
+	{
+		ReleaseRange(free_lists->instances, first, count);
+	});
+}
+
+bool Renderer::Vulkan::VulkanGeometryArena::AllocateRange(std::vector<FreeRange>& free_ranges, unsigned int count, unsigned int & first)
+{
+	for (auto it = free_ranges.begin(); it != free_ranges.end(); it++)
+	{
+		if (it->count < count) continue;
+		first = it->first;
+		it->first += count;
+		it->count -= count;
+		if (it->count == 0) free_ranges.erase(it);
+		return true;
+	}
+	return false;
+}
+
+void Renderer::Vulkan::VulkanGeometryArena::ReleaseRange(std::vector<FreeRange>& free_ranges, unsigned int first, unsigned int count)
+{
+	// The list is kept sorted so neighbours can be merged
+	auto it = free_ranges.begin();
+	while (it != free_ranges.end() && it->first < first) it++;
+	it = free_ranges.insert(it, { first, count });
+	auto next = it + 1;
+	if (next != free_ranges.end() && it->first + it->count == next->first)
+	{
+		it->count += next->count;
+		free_ranges.erase(next);
+	}
+	if (it != free_ranges.begin())
+	{
+		auto previous = it - 1;
+		if (previous->first + previous->count == it->first)
+		{
+			previous->count += it->count;
+			free_ranges.erase(it);
+		}
+	}
+}
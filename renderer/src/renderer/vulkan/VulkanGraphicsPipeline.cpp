@@ -7,6 +7,9 @@
 #include <renderer/vulkan/VulkanModelPool.hpp>
 #include <renderer/vulkan/VulkanDescriptorPool.hpp>
 #include <renderer/vulkan/VulkanDescriptorSet.hpp>
+#include <renderer/vulkan/VulkanBuffer.hpp>
+#include <renderer/vulkan/VulkanPhysicalDevice.hpp>
+#include <renderer/vulkan/VulkanCommandState.hpp>
 #include <renderer/ShaderStage.hpp>
 #include <renderer/DataFormat.hpp>
 #include <renderer/IModelPool.hpp>
@@ -14,10 +17,13 @@
 #include <glm/glm.hpp>
 
 #include <map>
+#include <algorithm>
 
 using namespace Renderer;
 using namespace Renderer::Vulkan;
 
+const unsigned int Renderer::Vulkan::VulkanGraphicsPipeline::m_draw_group_padding = 100;
+
 std::map<Renderer::ShaderStage, VkShaderStageFlagBits> Renderer::Vulkan::VulkanGraphicsPipeline::m_shader_stage_flags
 {
 { Renderer::ShaderStage::COMPUTE_SHADER , VkShaderStageFlagBits::VK_SHADER_STAGE_COMPUTE_BIT },
@@ -51,29 +57,39 @@ Renderer::Vulkan::VulkanGraphicsPipeline::VulkanGraphicsPipeline(VulkanDevice *
 
 	m_change = false;
 	m_topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkCommandPoolCreateInfo pool_info = VulkanInitializers::CommandPoolCreateInfo(m_device->GetVulkanPhysicalDevice()->GetQueueFamilies()->graphics_indices, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	ErrorCheck(vkCreateCommandPool(
+		*m_device->GetVulkanDevice(),
+		&pool_info,
+		m_device->GetAllocationCallbacks(),
+		&m_command_pool
+	));
+	assert(!HasError() && "Unable to create pipeline command pool");
 }
 
 Renderer::Vulkan::VulkanGraphicsPipeline::~VulkanGraphicsPipeline()
 {
-	vkDestroyPipeline(
-		*m_device->GetVulkanDevice(),
-		m_pipeline,
-		nullptr
-	);
-	vkDestroyPipelineLayout(
-		*m_device->GetVulkanDevice(),
-		m_pipeline_layout,
-		nullptr
-	);
-	for (int i = 0; i < m_shader_stages.size(); i++)
+	ReleaseCommandBuffers();
+	DestroyPipeline();
+	DestroyDrawGroups();
+	VkDevice device = *m_device->GetVulkanDevice();
+	const VkAllocationCallbacks* allocator = m_device->GetAllocationCallbacks();
+	std::vector<VkPipelineShaderStageCreateInfo> shader_stages = m_shader_stages;
+	// Queued after the command buffers are freed, so the pool outlives them
+	VkCommandPool command_pool = m_command_pool;
+	m_device->DeferDestroy([device, allocator, shader_stages, command_pool]()
 	{
-		vkDestroyShaderModule(
-			*m_device->GetVulkanDevice(),
-			m_shader_stages[i].module,
-			nullptr
-		);
-	}
-
+		vkDestroyCommandPool(device, command_pool, allocator);
+		for (int i = 0; i < shader_stages.size(); i++)
+		{
+			vkDestroyShaderModule(
+				device,
+				shader_stages[i].module,
+				allocator
+			);
+		}
+	});
 }
 
 bool Renderer::Vulkan::VulkanGraphicsPipeline::Build()
@@ -95,7 +111,7 @@ bool Renderer::Vulkan::VulkanGraphicsPipeline::CreatePipeline()
 	ErrorCheck(vkCreatePipelineLayout(
 		*m_device->GetVulkanDevice(),
 		&pipeline_layout_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_pipeline_layout
 	));
 
@@ -202,50 +218,80 @@ bool Renderer::Vulkan::VulkanGraphicsPipeline::CreatePipeline()
 		VK_NULL_HANDLE,
 		1,
 		&pipeline_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_pipeline
 	));
 
 	if (HasError())return false;
 
+	// The cached draws bind the old pipeline
+	InvalidateCommandBuffers();
+
 	return true;
 }
 
 void Renderer::Vulkan::VulkanGraphicsPipeline::DestroyPipeline()
 {
-	vkDestroyPipelineLayout(*m_device->GetVulkanDevice(), m_pipeline_layout, nullptr);
-	vkDestroyPipeline(*m_device->GetVulkanDevice(), m_pipeline, nullptr);
+	// Recorded command buffers may still be executing with the old pipeline
+	VkDevice device = *m_device->GetVulkanDevice();
+	const VkAllocationCallbacks* allocator = m_device->GetAllocationCallbacks();
+	VkPipelineLayout pipeline_layout = m_pipeline_layout;
+	VkPipeline pipeline = m_pipeline;
+	m_device->DeferDestroy([device, allocator, pipeline_layout, pipeline]()
+	{
+		vkDestroyPipelineLayout(device, pipeline_layout, allocator);
+		vkDestroyPipeline(device, pipeline, allocator);
+	});
+	m_pipeline = VK_NULL_HANDLE;
 }
 
 void Renderer::Vulkan::VulkanGraphicsPipeline::AttachToCommandBuffer(VkCommandBuffer & command_buffer)
 {
-	vkCmdBindPipeline(
-		command_buffer,
+	VulkanCommandState state(command_buffer);
+	AttachToCommandBuffer(state);
+	m_device->AddCommandStats(state.GetBindCount(), state.GetSkippedBindCount());
+}
+
+void Renderer::Vulkan::VulkanGraphicsPipeline::AttachToCommandBuffer(VulkanCommandState & state)
+{
+	state.BindPipeline(
 		VK_PIPELINE_BIND_POINT_GRAPHICS,
 		m_pipeline
 	);
 	for(auto it = m_descriptor_sets.begin(); it!= m_descriptor_sets.end(); it++)
 	{
-		vkCmdBindDescriptorSets(
-			command_buffer,
+		state.BindDescriptorSet(
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			m_pipeline_layout,
 			it->first,
-			1,
-			&it->second->GetDescriptorSet(),
-			0,
-			NULL
+			it->second->GetDescriptorSet()
 		);
 	}
-	for (auto model_pool : m_model_pools)
+	// Every command buffer in the chain is recorded with the same groups
+	if (m_rebuild_draw_groups)
+	{
+		BuildDrawGroups();
+	}
+	for (auto& group : m_draw_groups)
 	{
-		model_pool->AttachToCommandBuffer(command_buffer,this);
+		if (group.pools.size() == 1)
+		{
+			group.pools[0]->AttachToCommandBuffer(state, this);
+		}
+		else
+		{
+			// Pools in a group share their bindings, so bind once and draw everything together
+			group.pools[0]->AttachBindings(state, this);
+			AttachDrawGroup(state, group);
+		}
 	}
 }
 
 void Renderer::Vulkan::VulkanGraphicsPipeline::AttachModelPool(IModelPool * model_pool)
 {
 	m_model_pools.push_back(dynamic_cast<VulkanModelPool*>(model_pool));
+	m_rebuild_draw_groups = true;
+	m_device->MarkSceneChanged();
 }
 
 void Renderer::Vulkan::VulkanGraphicsPipeline::AttachVertexBinding(VertexBase vertex_binding)
@@ -282,17 +328,112 @@ void Renderer::Vulkan::VulkanGraphicsPipeline::DefinePrimitiveTopology(Primitive
 
 bool Renderer::Vulkan::VulkanGraphicsPipeline::HasChanged()
 {
+	bool changed = false;
 	if (m_change)
 	{
 		m_change = false;
-		return true;
+		changed = true;
 	}
-
+	// Every pool is polled so none of them is left flagged for another record next frame
 	for (auto pool : m_model_pools)
 	{
-		if (pool->HasChanged())return true;
+		if (pool->HasChanged()) changed = true;
+	}
+	if (!changed && !UpdateDrawGroups())
+	{
+		changed = true;
 	}
-	return false;
+	if (changed)
+	{
+		m_rebuild_draw_groups = true;
+		InvalidateCommandBuffers();
+	}
+	return changed;
+}
+
+VkCommandBuffer Renderer::Vulkan::VulkanGraphicsPipeline::GetCommandBuffer(uint32_t index, VkFramebuffer framebuffer)
+{
+	if (PrepareCommandBuffer(index))
+	{
+		RecordCommandBuffer(index, framebuffer);
+	}
+	return m_command_buffers[index];
+}
+
+bool Renderer::Vulkan::VulkanGraphicsPipeline::PrepareCommandBuffer(uint32_t index)
+{
+	if (m_command_buffers.empty())
+	{
+		m_command_buffers.resize(m_swapchain->GetImageCount());
+		VkCommandBufferAllocateInfo alloc_info = VulkanInitializers::CommandBufferAllocateInfo(
+			m_command_pool,
+			static_cast<uint32_t>(m_command_buffers.size()),
+			VK_COMMAND_BUFFER_LEVEL_SECONDARY
+		);
+		ErrorCheck(vkAllocateCommandBuffers(
+			*m_device->GetVulkanDevice(),
+			&alloc_info,
+			m_command_buffers.data()
+		));
+		assert(!HasError() && "Unable to allocate secondary command buffers");
+		m_dirty_command_buffers.assign(m_command_buffers.size(), true);
+	}
+	assert(index < m_command_buffers.size() && "Swapchain image has no command buffer");
+	if (!m_dirty_command_buffers[index]) return false;
+	// Building draw groups creates buffers, which has to happen on the main thread
+	if (m_rebuild_draw_groups)
+	{
+		BuildDrawGroups();
+	}
+	return true;
+}
+
+void Renderer::Vulkan::VulkanGraphicsPipeline::ReleaseCommandBuffers()
+{
+	if (m_command_buffers.empty()) return;
+	// Primary buffers still waiting to execute reference these
+	VkDevice device = *m_device->GetVulkanDevice();
+	VkCommandPool command_pool = m_command_pool;
+	std::vector<VkCommandBuffer> command_buffers = m_command_buffers;
+	m_device->DeferDestroy([device, command_pool, command_buffers]()
+	{
+		vkFreeCommandBuffers(device, command_pool, (uint32_t)command_buffers.size(), command_buffers.data());
+	});
+	m_command_buffers.clear();
+	m_dirty_command_buffers.clear();
+}
+
+void Renderer::Vulkan::VulkanGraphicsPipeline::InvalidateCommandBuffers()
+{
+	m_dirty_command_buffers.assign(m_command_buffers.size(), true);
+}
+
+void Renderer::Vulkan::VulkanGraphicsPipeline::RecordCommandBuffer(uint32_t index, VkFramebuffer framebuffer)
+{
+	VkCommandBuffer& command_buffer = m_command_buffers[index];
+	VkCommandBufferInheritanceInfo inheritance_info = VulkanInitializers::CommandBufferInheritanceInfo(*m_swapchain->GetRenderPass(), 0, framebuffer);
+	VkCommandBufferBeginInfo begin_info = VulkanInitializers::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+	begin_info.pInheritanceInfo = &inheritance_info;
+
+	vkResetCommandBuffer(
+		command_buffer,
+		0
+	);
+	ErrorCheck(vkBeginCommandBuffer(
+		command_buffer,
+		&begin_info
+	));
+	assert(!HasError() && "Unable to begin secondary command buffer");
+
+	// Dynamic state is not inherited from the primary buffer
+	m_swapchain->AttachDynamicState(command_buffer);
+	AttachToCommandBuffer(command_buffer);
+
+	ErrorCheck(vkEndCommandBuffer(
+		command_buffer
+	));
+	assert(!HasError() && "Unable to end secondary command buffer");
+	m_dirty_command_buffers[index] = false;
 }
 
 VkShaderStageFlagBits Renderer::Vulkan::VulkanGraphicsPipeline::GetShaderStageFlag(ShaderStage stage)
@@ -308,4 +449,178 @@ VkFormat Renderer::Vulkan::VulkanGraphicsPipeline::GetFormat(Renderer::DataForma
 VkVertexInputRate Renderer::Vulkan::VulkanGraphicsPipeline::GetVertexInputRate(Renderer::VertexInputRate input_rate)
 {
 	return m_vertex_input_rates[input_rate];
-}
\ No newline at end of file
+}
+
+void Renderer::Vulkan::VulkanGraphicsPipeline::BuildDrawGroups()
+{
+	DestroyDrawGroups();
+	for (auto pool : m_model_pools)
+	{
+		if (m_draw_groups.size() == 0 || !m_draw_groups.back().pools[0]->CanDrawWith(pool))
+		{
+			m_draw_groups.push_back(DrawGroup());
+		}
+		m_draw_groups.back().pools.push_back(pool);
+	}
+	for (auto& group : m_draw_groups)
+	{
+		// Any earlier change is picked up by the fill below
+		for (auto pool : group.pools)
+		{
+			pool->HaveDrawsChanged();
+		}
+		if (group.pools.size() == 1) continue;
+		FillDrawGroup(group);
+		bool indexed = group.pools[0]->Indexed();
+		unsigned int count = (unsigned int)(indexed ? group.indexed_commands.size() : group.vertex_commands.size());
+		if (count == 0) continue;
+		if (m_device->CanDrawIndirectCount(count + m_draw_group_padding))
+		{
+			// Spare room lets the group grow without recording again, the unused commands draw no instances
+			// Groups are not added after this point, so the count buffer can read straight from the group
+			group.draw_count = count;
+			count += m_draw_group_padding;
+			group.indexed_commands.resize(indexed ? count : 0);
+			group.vertex_commands.resize(indexed ? 0 : count);
+			group.count_buffer = new VulkanBuffer(m_device, BufferChain::Single, &group.draw_count, sizeof(uint32_t), 1,
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			group.count_buffer->SetData(BufferSlot::Primary);
+		}
+		unsigned int command_size = indexed ? sizeof(VkDrawIndexedIndirectCommand) : sizeof(VkDrawIndirectCommand);
+		void* commands = indexed ? (void*)group.indexed_commands.data() : (void*)group.vertex_commands.data();
+		group.indirect_buffer = new VulkanBuffer(m_device, BufferChain::Single, commands, command_size, count,
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		group.indirect_buffer->SetData(BufferSlot::Primary);
+	}
+	m_rebuild_draw_groups = false;
+}
+
+void Renderer::Vulkan::VulkanGraphicsPipeline::DestroyDrawGroups()
+{
+	for (auto& group : m_draw_groups)
+	{
+		delete group.indirect_buffer;
+		delete group.count_buffer;
+	}
+	m_draw_groups.clear();
+}
+
+bool Renderer::Vulkan::VulkanGraphicsPipeline::FillDrawGroup(DrawGroup & group)
+{
+	bool indexed = group.pools[0]->Indexed();
+	// Gathered on the side, once the indirect buffer exists the group arrays are its local data and must not reallocate
+	std::vector<VkDrawIndexedIndirectCommand> indexed_commands;
+	std::vector<VkDrawIndirectCommand> vertex_commands;
+	for (auto pool : group.pools)
+	{
+		if (indexed)
+		{
+			pool->GetDrawCommands(indexed_commands);
+		}
+		else
+		{
+			pool->GetDrawCommands(vertex_commands);
+		}
+	}
+	if (group.indirect_buffer == nullptr)
+	{
+		group.indexed_commands.swap(indexed_commands);
+		group.vertex_commands.swap(vertex_commands);
+		return true;
+	}
+	size_t old_count = indexed ? group.indexed_commands.size() : group.vertex_commands.size();
+	size_t new_count = indexed ? indexed_commands.size() : vertex_commands.size();
+	if (group.count_buffer != nullptr)
+	{
+		// Within the spare room only the count the GPU reads changes
+		if (new_count > old_count) return false;
+		group.draw_count = (uint32_t)new_count;
+		group.count_buffer->SetData(BufferSlot::Primary);
+	}
+	else if (new_count != old_count)
+	{
+		return false;
+	}
+	// The unused spare commands draw no instances
+	if (indexed)
+	{
+		std::copy(indexed_commands.begin(), indexed_commands.end(), group.indexed_commands.begin());
+		std::fill(group.indexed_commands.begin() + new_count, group.indexed_commands.end(), VkDrawIndexedIndirectCommand());
+	}
+	else
+	{
+		std::copy(vertex_commands.begin(), vertex_commands.end(), group.vertex_commands.begin());
+		std::fill(group.vertex_commands.begin() + new_count, group.vertex_commands.end(), VkDrawIndirectCommand());
+	}
+	return true;
+}
+
+bool Renderer::Vulkan::VulkanGraphicsPipeline::UpdateDrawGroups()
+{
+	for (auto& group : m_draw_groups)
+	{
+		if (group.pools.size() == 1) continue;
+		bool changed = false;
+		for (auto pool : group.pools)
+		{
+			if (pool->HaveDrawsChanged()) changed = true;
+		}
+		if (!changed) continue;
+		// A different number of draws needs the command buffers recording again
+		if (!FillDrawGroup(group) || group.indirect_buffer == nullptr) return false;
+		group.indirect_buffer->SetData(BufferSlot::Primary);
+	}
+	return true;
+}
+
+void Renderer::Vulkan::VulkanGraphicsPipeline::AttachDrawGroup(VulkanCommandState & state, DrawGroup & group)
+{
+	VkCommandBuffer& command_buffer = state.GetCommandBuffer();
+	if (group.indirect_buffer == nullptr) return;
+	bool indexed = group.pools[0]->Indexed();
+	if (group.count_buffer != nullptr)
+	{
+		m_device->CmdDrawIndirectCount(
+			command_buffer,
+			indexed,
+			group.indirect_buffer->GetBufferData(BufferSlot::Primary)->buffer,
+			group.count_buffer->GetBufferData(BufferSlot::Primary)->buffer,
+			group.indirect_buffer->GetElementCount(BufferSlot::Primary),
+			indexed ? sizeof(VkDrawIndexedIndirectCommand) : sizeof(VkDrawIndirectCommand)
+		);
+		return;
+	}
+	unsigned int count = (unsigned int)(indexed ? group.indexed_commands.size() : group.vertex_commands.size());
+	unsigned int stride = indexed ? sizeof(VkDrawIndexedIndirectCommand) : sizeof(VkDrawIndirectCommand);
+	VkBuffer buffer = group.indirect_buffer->GetBufferData(BufferSlot::Primary)->buffer;
+
+	// Check to see if we can render the whole group in one draw
+	if (m_device->GetVulkanPhysicalDevice()->GetDeviceFeatures()->multiDrawIndirect &&
+		m_device->GetVulkanPhysicalDevice()->GetPhysicalDeviceProperties()->limits.maxDrawIndirectCount >= count)
+	{
+		if (indexed)
+		{
+			vkCmdDrawIndexedIndirect(command_buffer, buffer, 0, count, stride);
+		}
+		else
+		{
+			vkCmdDrawIndirect(command_buffer, buffer, 0, count, stride);
+		}
+	}
+	else // If we cant, loop through for each draw
+	{
+		for (unsigned int j = 0; j < count; j++)
+		{
+			if (indexed)
+			{
+				vkCmdDrawIndexedIndirect(command_buffer, buffer, j * stride, 1, stride);
+			}
+			else
+			{
+				vkCmdDrawIndirect(command_buffer, buffer, j * stride, 1, stride);
+			}
+		}
+	}
+}
@@ -0,0 +1,175 @@
+#include <renderer/vulkan/VulkanHostAllocator.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+// Command scope allocations only live for the length of a single Vulkan call, so a small arena is plenty
+const size_t Renderer::Vulkan::VulkanHostAllocator::m_command_arena_size = 256 * 1024;
+// Object scope allocations are freed in any order, once the arena fills up with live objects they fall back to the heap
+const size_t Renderer::Vulkan::VulkanHostAllocator::m_object_arena_size = 4 * 1024 * 1024;
+
+Renderer::Vulkan::VulkanHostAllocator::VulkanHostAllocator()
+{
+	m_command_arena.memory = (char*)malloc(m_command_arena_size);
+	m_command_arena.size = m_command_arena.memory != nullptr ? m_command_arena_size : 0;
+	m_object_arena.memory = (char*)malloc(m_object_arena_size);
+	m_object_arena.size = m_object_arena.memory != nullptr ? m_object_arena_size : 0;
+
+	m_callbacks = {};
+	m_callbacks.pUserData = this;
+	m_callbacks.pfnAllocation = &AllocationCallback;
+	m_callbacks.pfnReallocation = &ReallocationCallback;
+	m_callbacks.pfnFree = &FreeCallback;
+	m_callbacks.pfnInternalAllocation = &InternalAllocationCallback;
+	m_callbacks.pfnInternalFree = &InternalFreeCallback;
+}
+
+Renderer::Vulkan::VulkanHostAllocator::~VulkanHostAllocator()
+{
+	free(m_command_arena.memory);
+	free(m_object_arena.memory);
+}
+
+const VkAllocationCallbacks * Renderer::Vulkan::VulkanHostAllocator::GetCallbacks()
+{
+	return &m_callbacks;
+}
+
+void Renderer::Vulkan::VulkanHostAllocator::GetHostMemoryStats(HostMemoryStats & stats)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	stats = m_stats;
+}
+
+void * Renderer::Vulkan::VulkanHostAllocator::Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0) return nullptr;
+	// The header sits directly in front of the returned pointer so it needs to be aligned too
+	if (alignment < alignof(AllocationHeader)) alignment = alignof(AllocationHeader);
+
+	AllocationHeader header = { nullptr, size, nullptr, scope };
+	void* memory = nullptr;
+	HostArena* arena = GetArena(scope);
+	if (arena != nullptr)
+	{
+		memory = AllocateFromArena(*arena, size, alignment);
+		if (memory != nullptr)
+		{
+			header.arena = arena;
+			m_stats.scopes[scope].arena_allocation_count++;
+		}
+	}
+	if (memory == nullptr)
+	{
+		size_t offset = sizeof(AllocationHeader) + alignment - 1;
+		char* raw = (char*)malloc(size + offset);
+		if (raw == nullptr) return nullptr;
+		memory = (void*)(((uintptr_t)raw + offset) & ~(uintptr_t)(alignment - 1));
+		header.raw = raw;
+	}
+	((AllocationHeader*)memory)[-1] = header;
+
+	HostScopeStats& stats = m_stats.scopes[scope];
+	stats.bytes += size;
+	stats.total_bytes += size;
+	if (stats.bytes > stats.peak_bytes) stats.peak_bytes = stats.bytes;
+	return memory;
+}
+
+void * Renderer::Vulkan::VulkanHostAllocator::Reallocate(void * original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (original == nullptr) return Allocate(size, alignment, scope);
+	if (size == 0)
+	{
+		Free(original);
+		return nullptr;
+	}
+	AllocationHeader* header = ((AllocationHeader*)original) - 1;
+	void* memory = Allocate(size, alignment, scope);
+	// On failure the original allocation has to be left untouched
+	if (memory == nullptr) return nullptr;
+	memcpy(memory, original, header->size < size ? header->size : size);
+	Free(original);
+	return memory;
+}
+
+void Renderer::Vulkan::VulkanHostAllocator::Free(void * memory)
+{
+	if (memory == nullptr) return;
+	AllocationHeader* header = ((AllocationHeader*)memory) - 1;
+	m_stats.scopes[header->scope].bytes -= header->size;
+	if (header->arena != nullptr)
+	{
+		// Rewind the arena once the last allocation in it is gone
+		header->arena->live_allocations--;
+		if (header->arena->live_allocations == 0) header->arena->head = 0;
+	}
+	else
+	{
+		free(header->raw);
+	}
+}
+
+void * Renderer::Vulkan::VulkanHostAllocator::AllocateFromArena(HostArena & arena, size_t size, size_t alignment)
+{
+	uintptr_t base = (uintptr_t)arena.memory;
+	uintptr_t start = (base + arena.head + sizeof(AllocationHeader) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	size_t end = (size_t)(start - base) + size;
+	if (end > arena.size) return nullptr;
+	arena.head = end;
+	arena.live_allocations++;
+	return (void*)start;
+}
+
+Renderer::Vulkan::VulkanHostAllocator::HostArena * Renderer::Vulkan::VulkanHostAllocator::GetArena(VkSystemAllocationScope scope)
+{
+	switch (scope)
+	{
+	case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+		return &m_command_arena;
+	case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+		return &m_object_arena;
+	default:
+		return nullptr;
+	}
+}
+
+VKAPI_ATTR void * VKAPI_CALL Renderer::Vulkan::VulkanHostAllocator::AllocationCallback(void * user_data, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	VulkanHostAllocator* allocator = (VulkanHostAllocator*)user_data;
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_stats.scopes[scope].allocation_count++;
+	return allocator->Allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void * VKAPI_CALL Renderer::Vulkan::VulkanHostAllocator::ReallocationCallback(void * user_data, void * original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	VulkanHostAllocator* allocator = (VulkanHostAllocator*)user_data;
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_stats.scopes[scope].reallocation_count++;
+	return allocator->Reallocate(original, size, alignment, scope);
+}
+
+VKAPI_ATTR void VKAPI_CALL Renderer::Vulkan::VulkanHostAllocator::FreeCallback(void * user_data, void * memory)
+{
+	if (memory == nullptr) return;
+	VulkanHostAllocator* allocator = (VulkanHostAllocator*)user_data;
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_stats.scopes[(((AllocationHeader*)memory) - 1)->scope].free_count++;
+	allocator->Free(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL Renderer::Vulkan::VulkanHostAllocator::InternalAllocationCallback(void * user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+	VulkanHostAllocator* allocator = (VulkanHostAllocator*)user_data;
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_stats.scopes[scope].internal_bytes += size;
+}
+
+VKAPI_ATTR void VKAPI_CALL Renderer::Vulkan::VulkanHostAllocator::InternalFreeCallback(void * user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+	VulkanHostAllocator* allocator = (VulkanHostAllocator*)user_data;
+	std::lock_guard<std::mutex> lock(allocator->m_mutex);
+	allocator->m_stats.scopes[scope].internal_bytes -= size;
+}
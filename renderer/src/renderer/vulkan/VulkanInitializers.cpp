@@ -67,12 +67,12 @@ VkCommandPoolCreateInfo Renderer::Vulkan::VulkanInitializers::CommandPoolCreateI
 	return pool_info;
 }
 
-VkCommandBufferAllocateInfo Renderer::Vulkan::VulkanInitializers::CommandBufferAllocateInfo(VkCommandPool pool, uint32_t command_buffer_count)
+VkCommandBufferAllocateInfo Renderer::Vulkan::VulkanInitializers::CommandBufferAllocateInfo(VkCommandPool pool, uint32_t command_buffer_count, VkCommandBufferLevel level)
 {
 	VkCommandBufferAllocateInfo alloc_info = {};
 	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	alloc_info.commandPool = pool;
-	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	alloc_info.level = level;
 	alloc_info.commandBufferCount = command_buffer_count;
 	return alloc_info;
 }
@@ -86,6 +86,16 @@ VkCommandBufferBeginInfo Renderer::Vulkan::VulkanInitializers::CommandBufferBegi
 	return begin_info;
 }
 
+VkCommandBufferInheritanceInfo Renderer::Vulkan::VulkanInitializers::CommandBufferInheritanceInfo(VkRenderPass render_pass, uint32_t subpass, VkFramebuffer framebuffer)
+{
+	VkCommandBufferInheritanceInfo inheritance_info = {};
+	inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance_info.renderPass = render_pass;
+	inheritance_info.subpass = subpass;
+	inheritance_info.framebuffer = framebuffer; // Only a hint, it may be null
+	return inheritance_info;
+}
+
 VkSubmitInfo Renderer::Vulkan::VulkanInitializers::SubmitInfo(VkCommandBuffer & buffer)
 {
 	VkSubmitInfo submit_info = {};
@@ -327,6 +337,29 @@ VkImageMemoryBarrier Renderer::Vulkan::VulkanInitializers::ImageMemoryBarrier(Vk
 	return barrier;
 }
 
+VkMemoryBarrier Renderer::Vulkan::VulkanInitializers::MemoryBarrier(VkAccessFlags src_access, VkAccessFlags dst_access)
+{
+	VkMemoryBarrier memory_barrier{};
+	memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memory_barrier.srcAccessMask = src_access;
+	memory_barrier.dstAccessMask = dst_access;
+	return memory_barrier;
+}
+
+VkBufferMemoryBarrier Renderer::Vulkan::VulkanInitializers::BufferMemoryBarrier(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkAccessFlags src_access, VkAccessFlags dst_access)
+{
+	VkBufferMemoryBarrier buffer_memory_barrier{};
+	buffer_memory_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	buffer_memory_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	buffer_memory_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	buffer_memory_barrier.buffer = buffer;
+	buffer_memory_barrier.offset = offset;
+	buffer_memory_barrier.size = size;
+	buffer_memory_barrier.srcAccessMask = src_access;
+	buffer_memory_barrier.dstAccessMask = dst_access;
+	return buffer_memory_barrier;
+}
+
 VkBufferCreateInfo Renderer::Vulkan::VulkanInitializers::BufferCreateInfo(VkDeviceSize size, VkBufferUsageFlags usage)
 {
 	VkBufferCreateInfo buffer_info = {};
@@ -373,10 +406,11 @@ VkDescriptorSetLayoutBinding Renderer::Vulkan::VulkanInitializers::DescriptorSet
 	return layout_bindings;
 }
 
-VkDescriptorPoolCreateInfo Renderer::Vulkan::VulkanInitializers::DescriptorPoolCreateInfo(std::vector<VkDescriptorPoolSize>& pool_sizes, uint32_t max_sets)
+VkDescriptorPoolCreateInfo Renderer::Vulkan::VulkanInitializers::DescriptorPoolCreateInfo(std::vector<VkDescriptorPoolSize>& pool_sizes, uint32_t max_sets, VkDescriptorPoolCreateFlags flags)
 {
 	VkDescriptorPoolCreateInfo create_info = {};
 	create_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	create_info.flags = flags;
 	create_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
 	create_info.pPoolSizes = pool_sizes.data();
 	create_info.maxSets = max_sets;
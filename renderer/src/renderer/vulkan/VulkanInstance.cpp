@@ -1,5 +1,6 @@
 #include <renderer/vulkan/VulkanInstance.hpp>
 #include <renderer\vulkan\VulkanCommon.hpp>
+#include <renderer/vulkan/VulkanHostAllocator.hpp>
 
 #include <assert.h>
 #include <iostream>
@@ -8,6 +9,7 @@ using namespace Renderer::Vulkan;
 
 VulkanInstance::VulkanInstance()
 {
+	m_host_allocator = new VulkanHostAllocator();
 	SetupLayersAndExtensions();
 	assert(CheckLayersSupport() && "Unsupported Layers");
 	InitVulkanInstance();
@@ -16,6 +18,8 @@ VulkanInstance::VulkanInstance()
 VulkanInstance::~VulkanInstance()
 {
 	DeInitVulkanInstance();
+	delete m_host_allocator;
+	m_host_allocator = nullptr;
 }
 
 VkInstance * VulkanInstance::GetInstance()
@@ -23,6 +27,25 @@ VkInstance * VulkanInstance::GetInstance()
 	return &m_instance;
 }
 
+const VkAllocationCallbacks * Renderer::Vulkan::VulkanInstance::GetAllocationCallbacks()
+{
+	return m_host_allocator->GetCallbacks();
+}
+
+Renderer::Vulkan::VulkanHostAllocator * Renderer::Vulkan::VulkanInstance::GetHostAllocator()
+{
+	return m_host_allocator;
+}
+
+bool Renderer::Vulkan::VulkanInstance::HasExtension(const char * extension_name)
+{
+	for (const char* extension : m_instance_extensions)
+	{
+		if (strcmp(extension, extension_name) == 0) return true;
+	}
+	return false;
+}
+
 
 void VulkanInstance::SetupLayersAndExtensions()
 {
@@ -49,6 +72,29 @@ void VulkanInstance::SetupLayersAndExtensions()
 #   error "Unknown compiler"
 #endif
 
+	uint32_t extension_count = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> available_extensions(extension_count);
+	vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, available_extensions.data());
+	for (const char* extension : GetOptionalExtensions())
+	{
+		for (const auto& available_extension : available_extensions)
+		{
+			if (strcmp(extension, available_extension.extensionName) == 0)
+			{
+				m_instance_extensions.push_back(extension);
+				break;
+			}
+		}
+	}
+}
+
+std::vector<const char*> Renderer::Vulkan::VulkanInstance::GetOptionalExtensions()
+{
+	return{
+		// Needed to query extended device properties such as the memory budget
+		VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME
+	};
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL MyDebugReportCallback(
@@ -83,7 +129,7 @@ void VulkanInstance::InitVulkanInstance()
 	);
 	ErrorCheck(vkCreateInstance(
 		&create_info,									// Information to pass to the function
-		NULL,											// Memory allocation callback
+		GetAllocationCallbacks(),						// Memory allocation callback
 		&m_instance										// The Vulkan instance to be initialized
 	));
 	/*
@@ -116,7 +162,7 @@ void VulkanInstance::DeInitVulkanInstance()
 {
 	vkDestroyInstance(
 		m_instance,
-		NULL
+		GetAllocationCallbacks()
 	);
 }
 
@@ -0,0 +1,297 @@
+#include <renderer/vulkan/VulkanMemoryAllocator.hpp>
+#include <renderer/vulkan/VulkanDevice.hpp>
+#include <renderer/vulkan/VulkanPhysicalDevice.hpp>
+#include <renderer/vulkan/VulkanCommon.hpp>
+
+#include <assert.h>
+#include <algorithm>
+
+// Smallest allocation is 256 bytes, this also covers the largest nonCoherentAtomSize allowed by the spec
+const uint32_t Renderer::Vulkan::VulkanMemoryAllocator::m_min_order = 8;
+// Largest shared block is 64MB
+const uint32_t Renderer::Vulkan::VulkanMemoryAllocator::m_max_block_order = 26;
+
+Renderer::Vulkan::VulkanMemoryAllocator::VulkanMemoryAllocator(VulkanDevice * device)
+{
+	m_device = device;
+	m_blocks.resize(VK_MAX_MEMORY_TYPES * 2);
+	m_type_stats.resize(VK_MAX_MEMORY_TYPES);
+}
+
+Renderer::Vulkan::VulkanMemoryAllocator::~VulkanMemoryAllocator()
+{
+	for (auto& blocks : m_blocks)
+	{
+		for (auto block : blocks)
+		{
+			DestroyBlock(block);
+		}
+		blocks.clear();
+	}
+}
+
+bool Renderer::Vulkan::VulkanMemoryAllocator::Allocate(const VkMemoryRequirements & requirements, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred, bool linear, VulkanAllocation & allocation, MemoryCategory category)
+{
+	uint32_t memory_type = VulkanCommon::FindMemoryType(
+		m_device->GetVulkanPhysicalDevice(),
+		requirements.memoryTypeBits,
+		properties,
+		preferred
+	);
+	if (memory_type == UINT32_MAX) return false;
+
+	allocation.memory_type = memory_type;
+	allocation.category = category;
+	allocation.property_flags = m_device->GetVulkanPhysicalDevice()->GetPhysicalDeviceMemoryProperties()->memoryTypes[memory_type].propertyFlags;
+
+	// Buddy blocks are aligned to their own size, so rounding up to the alignment satisfies it
+	VkDeviceSize size = requirements.size > requirements.alignment ? requirements.size : requirements.alignment;
+	uint32_t order = GetOrder(size);
+	if (order < m_min_order) order = m_min_order;
+
+	uint32_t block_order = GetBlockOrder(memory_type);
+
+	// Anything larger than a shared block gets its own memory allocation
+	if (order > block_order)
+	{
+		VulkanMemoryBlock* block = CreateBlock(memory_type, requirements.size, linear, true);
+		if (block == nullptr) return false;
+		block->used = block->size;
+		block->allocation_count = 1;
+		allocation.memory = block->memory;
+		allocation.offset = 0;
+		allocation.size = block->size;
+		allocation.mapped_memory = block->mapped_memory;
+		allocation.block = block;
+		allocation.order = 0;
+		TrackAllocation(allocation, true);
+		return true;
+	}
+
+	std::vector<VulkanMemoryBlock*>& blocks = GetBlocks(memory_type, linear);
+	VkDeviceSize offset = 0;
+	VulkanMemoryBlock* chosen_block = nullptr;
+	for (auto block : blocks)
+	{
+		if (AllocateFromBlock(block, order, offset))
+		{
+			chosen_block = block;
+			break;
+		}
+	}
+	// No room in the existing blocks, create a new one
+	if (chosen_block == nullptr)
+	{
+		chosen_block = CreateBlock(memory_type, (VkDeviceSize)1 << block_order, linear, false);
+		if (chosen_block == nullptr) return false;
+		blocks.push_back(chosen_block);
+		if (!AllocateFromBlock(chosen_block, order, offset)) return false;
+	}
+
+	chosen_block->used += (VkDeviceSize)1 << order;
+	chosen_block->allocation_count++;
+
+	allocation.memory = chosen_block->memory;
+	allocation.offset = offset;
+	allocation.size = (VkDeviceSize)1 << order;
+	allocation.mapped_memory = chosen_block->mapped_memory != nullptr ? ((char*)chosen_block->mapped_memory) + offset : nullptr;
+	allocation.block = chosen_block;
+	allocation.order = order;
+	TrackAllocation(allocation, true);
+	return true;
+}
+
+void Renderer::Vulkan::VulkanMemoryAllocator::Free(VulkanAllocation & allocation)
+{
+	VulkanMemoryBlock* block = allocation.block;
+	if (block == nullptr) return;
+	TrackAllocation(allocation, false);
+
+	if (block->dedicated)
+	{
+		DestroyBlock(block);
+	}
+	else
+	{
+		FreeToBlock(block, allocation.order, allocation.offset);
+		block->used -= (VkDeviceSize)1 << allocation.order;
+		block->allocation_count--;
+
+		// Release empty blocks, but keep the last one around so we do not thrash vkAllocateMemory
+		std::vector<VulkanMemoryBlock*>& blocks = GetBlocks(block->memory_type, block->linear);
+		if (block->allocation_count == 0 && blocks.size() > 1)
+		{
+			blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+			DestroyBlock(block);
+		}
+	}
+	allocation = VulkanAllocation();
+}
+
+Renderer::Vulkan::VulkanMemoryBlock * Renderer::Vulkan::VulkanMemoryAllocator::CreateBlock(uint32_t memory_type, VkDeviceSize size, bool linear, bool dedicated)
+{
+	VkMemoryAllocateInfo alloc_info = VulkanInitializers::MemoryAllocateInfo(size, memory_type);
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	ErrorCheck(vkAllocateMemory(
+		*m_device->GetVulkanDevice(),
+		&alloc_info,
+		m_device->GetAllocationCallbacks(),
+		&memory
+	));
+	if (HasError()) return nullptr;
+
+	VulkanMemoryBlock* block = new VulkanMemoryBlock();
+	block->memory = memory;
+	block->size = size;
+	block->memory_type = memory_type;
+	block->linear = linear;
+	block->dedicated = dedicated;
+	m_type_stats[memory_type].allocated += size;
+	m_type_stats[memory_type].block_count++;
+
+	// Host visible blocks stay mapped for their whole lifetime
+	if (m_device->GetVulkanPhysicalDevice()->GetPhysicalDeviceMemoryProperties()->memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		ErrorCheck(vkMapMemory(
+			*m_device->GetVulkanDevice(),
+			memory,
+			0,
+			VK_WHOLE_SIZE,
+			0,
+			&block->mapped_memory
+		));
+		assert(!HasError() && "Unable to map memory block");
+	}
+
+	if (!dedicated)
+	{
+		uint32_t block_order = GetOrder(size);
+		block->free_lists.resize(block_order + 1);
+		block->free_lists[block_order].insert(0);
+	}
+	return block;
+}
+
+void Renderer::Vulkan::VulkanMemoryAllocator::GetMemoryStats(MemoryStats & stats)
+{
+	VkPhysicalDeviceMemoryProperties* properties = m_device->GetVulkanPhysicalDevice()->GetPhysicalDeviceMemoryProperties();
+	stats.heaps.resize(properties->memoryHeapCount);
+	for (uint32_t i = 0; i < properties->memoryHeapCount; i++)
+	{
+		stats.heaps[i] = MemoryHeapStats();
+		stats.heaps[i].size = properties->memoryHeaps[i].size;
+		stats.heaps[i].device_local = (properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+	stats.types.resize(properties->memoryTypeCount);
+	for (uint32_t i = 0; i < properties->memoryTypeCount; i++)
+	{
+		VkMemoryPropertyFlags flags = properties->memoryTypes[i].propertyFlags;
+		stats.types[i] = m_type_stats[i];
+		stats.types[i].heap_index = properties->memoryTypes[i].heapIndex;
+		stats.types[i].device_local = (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+		stats.types[i].host_visible = (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+		stats.types[i].host_coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+		stats.types[i].host_cached = (flags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+		stats.heaps[stats.types[i].heap_index].allocated += m_type_stats[i].allocated;
+		stats.heaps[stats.types[i].heap_index].used += m_type_stats[i].used;
+	}
+	for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+	{
+		stats.categories[i] = m_category_stats[i];
+	}
+}
+
+void Renderer::Vulkan::VulkanMemoryAllocator::DestroyBlock(VulkanMemoryBlock * block)
+{
+	m_type_stats[block->memory_type].allocated -= block->size;
+	m_type_stats[block->memory_type].block_count--;
+	if (block->mapped_memory != nullptr)
+	{
+		vkUnmapMemory(*m_device->GetVulkanDevice(), block->memory);
+	}
+	vkFreeMemory(
+		*m_device->GetVulkanDevice(),
+		block->memory,
+		m_device->GetAllocationCallbacks()
+	);
+	delete block;
+}
+
+bool Renderer::Vulkan::VulkanMemoryAllocator::AllocateFromBlock(VulkanMemoryBlock * block, uint32_t order, VkDeviceSize & offset)
+{
+	uint32_t block_order = (uint32_t)block->free_lists.size() - 1;
+	// Find the smallest free block that can fit the request
+	uint32_t current = order;
+	while (current <= block_order && block->free_lists[current].empty()) current++;
+	if (current > block_order) return false;
+
+	offset = *block->free_lists[current].begin();
+	block->free_lists[current].erase(block->free_lists[current].begin());
+
+	// Split it down until it is the requested size, handing the upper halves back to the free lists
+	while (current > order)
+	{
+		current--;
+		block->free_lists[current].insert(offset + ((VkDeviceSize)1 << current));
+	}
+	return true;
+}
+
+void Renderer::Vulkan::VulkanMemoryAllocator::FreeToBlock(VulkanMemoryBlock * block, uint32_t order, VkDeviceSize offset)
+{
+	uint32_t block_order = (uint32_t)block->free_lists.size() - 1;
+	// Merge with the buddy for as long as it is free
+	while (order < block_order)
+	{
+		VkDeviceSize buddy = offset ^ ((VkDeviceSize)1 << order);
+		auto it = block->free_lists[order].find(buddy);
+		if (it == block->free_lists[order].end()) break;
+		block->free_lists[order].erase(it);
+		if (buddy < offset) offset = buddy;
+		order++;
+	}
+	block->free_lists[order].insert(offset);
+}
+
+void Renderer::Vulkan::VulkanMemoryAllocator::TrackAllocation(const VulkanAllocation & allocation, bool allocated)
+{
+	MemoryTypeStats& type_stats = m_type_stats[allocation.memory_type];
+	MemoryCategoryStats& category_stats = m_category_stats[allocation.category];
+	if (allocated)
+	{
+		type_stats.used += allocation.size;
+		type_stats.allocation_count++;
+		category_stats.used += allocation.size;
+		category_stats.allocation_count++;
+	}
+	else
+	{
+		type_stats.used -= allocation.size;
+		type_stats.allocation_count--;
+		category_stats.used -= allocation.size;
+		category_stats.allocation_count--;
+	}
+}
+
+std::vector<Renderer::Vulkan::VulkanMemoryBlock*>& Renderer::Vulkan::VulkanMemoryAllocator::GetBlocks(uint32_t memory_type, bool linear)
+{
+	return m_blocks[(memory_type * 2) + (linear ? 1 : 0)];
+}
+
+uint32_t Renderer::Vulkan::VulkanMemoryAllocator::GetBlockOrder(uint32_t memory_type)
+{
+	VkPhysicalDeviceMemoryProperties* properties = m_device->GetVulkanPhysicalDevice()->GetPhysicalDeviceMemoryProperties();
+	VkDeviceSize heap_size = properties->memoryHeaps[properties->memoryTypes[memory_type].heapIndex].size;
+	// Small heaps such as the 256MB BAR window should not be eaten by a handful of blocks
+	uint32_t block_order = m_max_block_order;
+	while (block_order > m_min_order && ((VkDeviceSize)1 << block_order) > heap_size / 8) block_order--;
+	return block_order;
+}
+
+uint32_t Renderer::Vulkan::VulkanMemoryAllocator::GetOrder(VkDeviceSize size)
+{
+	uint32_t order = 0;
+	while (((VkDeviceSize)1 << order) < size) order++;
+	return order;
+}
@@ -1,8 +1,8 @@
 #include <renderer/vulkan/VulkanModel.hpp>
 #include <renderer\vulkan\VulkanModelPool.hpp>
 
-Renderer::Vulkan::VulkanModel::VulkanModel(VulkanModelPool* pool, unsigned int model_pool_index) :
-	IModel(model_pool_index), m_pool(pool)
+Renderer::Vulkan::VulkanModel::VulkanModel(VulkanModelPool* pool, VulkanSlotHandle handle) :
+	IModel(handle.index), m_pool(pool), m_handle(handle)
 {
 	m_rendering = false;
 }
@@ -22,3 +22,8 @@ Renderer::IModelPool * Renderer::Vulkan::VulkanModel::GetModelPool()
 {
 	return m_pool;
 }
+
+Renderer::Vulkan::VulkanSlotHandle Renderer::Vulkan::VulkanModel::GetHandle()
+{
+	return m_handle;
+}
@@ -6,10 +6,16 @@
 #include <renderer/vulkan/VulkanDescriptorSet.hpp>
 #include <renderer/vulkan/VulkanPipeline.hpp>
 #include <renderer/vulkan/VulkanPhysicalDevice.hpp>
+#include <renderer/vulkan/VulkanGeometryArena.hpp>
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
 
 
 
 const unsigned int Renderer::Vulkan::VulkanModelPool::m_indirect_array_padding = 100;
+const unsigned int Renderer::Vulkan::VulkanModelPool::m_remap_hidden = 0xFFFFFFFF;
 
 Renderer::Vulkan::VulkanModelPool::VulkanModelPool(VulkanDevice * device, IVertexBuffer * vertex_buffer) :
 	IModelPool(vertex_buffer)
@@ -35,96 +41,187 @@ Renderer::Vulkan::VulkanModelPool::VulkanModelPool(VulkanDevice* device, IVertex
 	ResizeIndirectArray(m_indirect_array_padding);
 }
 
+Renderer::Vulkan::VulkanModelPool::VulkanModelPool(VulkanDevice * device, VulkanGeometryArena * geometry_arena, MeshRange mesh) :
+	IModelPool(geometry_arena->GetVertexBuffer(), geometry_arena->GetIndexBuffer())
+{
+	m_device = device;
+	m_geometry_arena = geometry_arena;
+	m_mesh = mesh;
+	m_indexed = mesh.index_count > 0;
+	m_current_index = 0;
+	m_largest_index = 0;
+	m_vertex_draw_count = m_indexed ? mesh.index_count : mesh.vertex_count;
+	m_change = false;
+
+	ResizeIndirectArray(m_indirect_array_padding);
+}
+
 Renderer::Vulkan::VulkanModelPool::~VulkanModelPool()
 {
 	delete m_indirect_draw_buffer;
+	delete m_draw_count_buffer;
+	delete m_remap_buffer;
+	delete m_remap_draw_buffer;
+	if (m_geometry_arena != nullptr)
+	{
+		m_geometry_arena->ReleaseInstances(m_first_instance, m_instance_count);
+	}
 }
 
 Renderer::IModel * Renderer::Vulkan::VulkanModelPool::CreateModel()
 {
-	unsigned int new_index = 0;
-	if (m_free_indexs.size() > 0)
+	UpdateModelBufferTable();
+	VulkanModel* model = AddModel();
+	if (model == nullptr) return nullptr;
+	// Draws that read their count from the GPU, or draw through the remap, pick the new model up without recording again
+	if (m_remap_buffer == nullptr && !UsesDrawCount())
 	{
-		// Get a index from the free array
-		new_index = m_free_indexs[0];
-		// Remove the index from the free array
-		m_free_indexs.erase(m_free_indexs.begin());
-	}
-	else
-	{
-		new_index = m_current_index;
-		m_current_index++;
-		m_largest_index = m_current_index;
+		m_change = true;
 	}
+	m_device->MarkSceneChanged();
 
 
+	return model;
+}
 
-	VulkanModel* model = new VulkanModel(this, new_index);
-	m_models[new_index] = model;
-	for (auto buffer = m_buffers.begin(); buffer != m_buffers.end(); buffer++)
+unsigned int Renderer::Vulkan::VulkanModelPool::CreateModels(unsigned int count, IModel ** models)
+{
+	if (count == 0) return 0;
+	// Grow the buffers once up front rather than a padding's worth at a time
+	// If the arena can not fit that many, models are added one at a time below until it runs out
+	unsigned int largest_index = std::max(m_current_index, m_models.GetSlotCount()) + count;
+	if (largest_index + 1 >= m_indirect_draw_buffer->GetElementCount(BufferSlot::Primary) ||
+		(m_geometry_arena != nullptr && largest_index > m_instance_count))
 	{
-		void* data = buffer->second->GetDataPointer(BufferSlot::Primary);
-		model->SetDataPointer(buffer->first, ((char*)data) + (buffer->second->GetIndexSize(BufferSlot::Primary) * new_index));
+		ResizeIndirectArray(largest_index + m_indirect_array_padding);
 	}
-	m_change = true;
+	if (m_remap_buffer != nullptr)
+	{
+		ReserveRemap(m_visible_count + count);
+	}
+	UpdateModelBufferTable();
+	BeginBatch();
+	unsigned int created = 0;
+	for (; created < count; created++)
+	{
+		models[created] = AddModel();
+		if (models[created] == nullptr) break;
+	}
+	for (unsigned int i = created; i < count; i++)
+	{
+		models[i] = nullptr;
+	}
+	EndBatch();
+	if (created == 0) return 0;
+	if (m_remap_buffer == nullptr && !UsesDrawCount())
+	{
+		m_change = true;
+	}
+	m_device->MarkSceneChanged();
+	return created;
+}
 
-	Render(new_index, true);
+void Renderer::Vulkan::VulkanModelPool::RemoveModels(IModel ** models, unsigned int count)
+{
+	BeginBatch();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		RemoveModel(models[i]);
+	}
+	EndBatch();
+}
 
+void Renderer::Vulkan::VulkanModelPool::SetVisibility(const unsigned int * indices, const bool * visible, unsigned int count)
+{
+	BeginBatch();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		VulkanModel** model = m_models.GetAt(indices[i]);
+		if (model == nullptr || (*model)->Rendering() == visible[i]) continue;
+		(*model)->ShouldRender(visible[i]);
+	}
+	EndBatch();
+	m_device->MarkSceneChanged();
+}
 
-	return model;
+void Renderer::Vulkan::VulkanModelPool::SetVisibilityMask(const std::vector<bool>& mask)
+{
+	BeginBatch();
+	for (auto model : m_models)
+	{
+		unsigned int index = model->GetModelPoolIndex();
+		bool visible = index < mask.size() && mask[index];
+		if (model->Rendering() == visible) continue;
+		model->ShouldRender(visible);
+	}
+	EndBatch();
+	m_device->MarkSceneChanged();
 }
 
 Renderer::IModel* Renderer::Vulkan::VulkanModelPool::GetModel(int index)
 {
-	return m_models[index];
+	VulkanModel** model = m_models.GetAt(index);
+	return model != nullptr ? *model : nullptr;
 }
 
 void Renderer::Vulkan::VulkanModelPool::RemoveModel(IModel * model)
 {
-	unsigned int index = model->GetModelPoolIndex();
-	auto it = m_models.find(index);
-	// Do we have that index and dose the model match out records
-	if (it != m_models.end() && it->second == model)
+	// CreateModels leaves null entries for models it could not create
+	if (model == nullptr) return;
+	VulkanModel* vulkan_model = static_cast<VulkanModel*>(model);
+	// Look the model up by the handle it was created with, the generation stops it matching a newer model that reused its slot
+	VulkanModel** found = m_models.Get(vulkan_model->GetHandle());
+	// Do we have that handle and dose the model match out records
+	if (found != nullptr && *found == model)
 	{
 
 		model->ShouldRender(false);
 
-		// Remove local model record
-		m_models.erase(it);
-
-		// Add the index to the free array
-		m_free_indexs.push_back(index);
+		// Remove local model record, its index is handed to the next model created
+		m_models.Remove(vulkan_model->GetHandle());
 
 		delete model;
 		model = nullptr;
 
-		m_change = true;
+		// The draw stays in the indirect buffer with no instances, so the recorded command buffers are still valid
+		m_device->MarkSceneChanged();
 	}
 
 }
 
 void Renderer::Vulkan::VulkanModelPool::Update()
 {
-	for (auto it = m_buffers.begin(); it != m_buffers.end(); it++)
+	for (auto it = GetBuffers().begin(); it != GetBuffers().end(); it++)
 	{
-		it->second->SetData(BufferSlot::Primary);
+		if (m_geometry_arena != nullptr)
+		{
+			// Only this pools range, the rest of the arena buffer belongs to other pools
+			if (m_current_index > 0) it->second->SetData(BufferSlot::Primary, m_first_instance, m_current_index);
+		}
+		else
+		{
+			it->second->SetData(BufferSlot::Primary);
+		}
 	}
 }
 
 void Renderer::Vulkan::VulkanModelPool::AttachBuffer(unsigned int index, IUniformBuffer * buffer)
 {
+	assert(m_geometry_arena == nullptr && "Pools drawing from a geometry arena use the buffers attached to the arena");
+	assert(index < IModel::MAX_MODEL_BUFFERS && "Model buffer index out of range");
 	m_buffers[index] = dynamic_cast<VulkanUniformBuffer*>(buffer);
 }
 
 void Renderer::Vulkan::VulkanModelPool::UpdateModelBuffer(unsigned int index)
 {
-	for (auto& it : m_models)
+	assert(index < IModel::MAX_MODEL_BUFFERS && "Model buffer index out of range");
+	auto buffer = GetBuffers().find(index);
+	if (buffer == GetBuffers().end()) return;
+	unsigned int index_size = buffer->second->GetIndexSize(BufferSlot::Primary);
+	char* data = (char*)buffer->second->GetDataPointer(BufferSlot::Primary) + index_size * m_first_instance;
+	for (auto model : m_models)
 	{
-		if (it.second != nullptr)
-		{
-			void* data = m_buffers[index]->GetDataPointer(BufferSlot::Primary);
-			it.second->SetDataPointer(index, ((char*)data) + (m_buffers[index]->GetIndexSize(BufferSlot::Primary) * it.first));
-		}
+		model->SetDataPointer(index, data + index_size * model->GetModelPoolIndex());
 	}
 }
 
@@ -165,6 +262,70 @@ void Renderer::Vulkan::VulkanModelPool::SetVertexDrawCount(unsigned int count)
 		}
 	}
 	m_indirect_draw_buffer->SetData(BufferSlot::Primary);
+	m_draws_changed = true;
+	if (m_remap_buffer != nullptr)
+	{
+		UpdateRemapCommand();
+	}
+}
+
+void Renderer::Vulkan::VulkanModelPool::SetInstanceRemap(bool remap)
+{
+	if (remap == (m_remap_buffer != nullptr)) return;
+	if (!remap)
+	{
+		// Frames in flight may still draw through the remap
+		delete m_remap_buffer;
+		delete m_remap_draw_buffer;
+		m_remap_buffer = nullptr;
+		m_remap_draw_buffer = nullptr;
+		m_remap.clear();
+		m_remap_positions.clear();
+		m_visible_count = 0;
+	}
+	else
+	{
+		// The per model commands stay up to date either way, so they say which models are visible
+		m_remap.assign(m_current_index + m_indirect_array_padding, 0);
+		m_remap_positions.assign(m_current_index + m_indirect_array_padding, m_remap_hidden);
+		m_visible_count = 0;
+		for (unsigned int i = 0; i < m_current_index; i++)
+		{
+			bool visible = Indexed() ? m_indexed_indirect_command[i].instanceCount > 0 : m_vertex_indirect_command[i].instanceCount > 0;
+			if (!visible) continue;
+			m_remap_positions[i] = m_visible_count;
+			m_remap[m_visible_count] = m_first_instance + i;
+			m_visible_count++;
+		}
+		m_remap_buffer = new VulkanBuffer(m_device, BufferChain::Single, m_remap.data(), sizeof(uint32_t), (unsigned int)m_remap.size(),
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		m_remap_buffer->SetData(BufferSlot::Primary);
+
+		m_remap_indexed_command.indexCount = m_vertex_draw_count;
+		m_remap_indexed_command.firstIndex = m_mesh.first_index;
+		m_remap_indexed_command.vertexOffset = m_mesh.first_vertex;
+		m_remap_indexed_command.firstInstance = 0;
+		m_remap_vertex_command.vertexCount = m_vertex_draw_count;
+		m_remap_vertex_command.firstVertex = m_mesh.first_vertex;
+		m_remap_vertex_command.firstInstance = 0;
+		if (Indexed())
+		{
+			m_remap_draw_buffer = new VulkanBuffer(m_device, BufferChain::Single, &m_remap_indexed_command, sizeof(VkDrawIndexedIndirectCommand), 1,
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+		else
+		{
+			m_remap_draw_buffer = new VulkanBuffer(m_device, BufferChain::Single, &m_remap_vertex_command, sizeof(VkDrawIndirectCommand), 1,
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		}
+		UpdateRemapCommand();
+	}
+	// The pool binds and draws differently, and can no longer share a draw group
+	m_change = true;
+	m_device->MarkSceneChanged();
 }
 
 unsigned int Renderer::Vulkan::VulkanModelPool::GetLargestIndex()
@@ -172,25 +333,26 @@ unsigned int Renderer::Vulkan::VulkanModelPool::GetLargestIndex()
 	return m_largest_index;
 }
 
-void Renderer::Vulkan::VulkanModelPool::AttachToCommandBuffer(VkCommandBuffer & command_buffer, VulkanPipeline* pipeline)
+void Renderer::Vulkan::VulkanModelPool::AttachToCommandBuffer(VulkanCommandState & state, VulkanPipeline* pipeline)
+{
+	AttachBindings(state, pipeline);
+	AttachDraws(state.GetCommandBuffer());
+}
+
+void Renderer::Vulkan::VulkanModelPool::AttachBindings(VulkanCommandState & state, VulkanPipeline * pipeline)
 {
 	VkDeviceSize offsets[] = { 0 };
 	for(auto it = m_descriptor_sets.begin(); it!= m_descriptor_sets.end(); it++)
 	{
-		vkCmdBindDescriptorSets(
-			command_buffer,
+		state.BindDescriptorSet(
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
 			pipeline->GetPipelineLayout(),
 			it->first,
-			1,
-			&it->second->GetDescriptorSet(),
-			0,
-			NULL
+			it->second->GetDescriptorSet()
 		);
 	}
 
-	vkCmdBindVertexBuffers(
-		command_buffer,
+	state.BindVertexBuffers(
 		0,
 		1,
 		&dynamic_cast<VulkanVertexBuffer*>(m_vertex_buffer)->GetBufferData(BufferSlot::Primary)->buffer,
@@ -199,8 +361,7 @@ void Renderer::Vulkan::VulkanModelPool::AttachToCommandBuffer(VkCommandBuffer &
 
 	if (Indexed())
 	{
-		vkCmdBindIndexBuffer(
-			command_buffer,
+		state.BindIndexBuffer(
 			dynamic_cast<VulkanIndexBuffer*>(m_index_buffer)->GetBufferData(BufferSlot::Primary)->buffer,
 			0,
 			VK_INDEX_TYPE_UINT16
@@ -208,23 +369,74 @@ void Renderer::Vulkan::VulkanModelPool::AttachToCommandBuffer(VkCommandBuffer &
 	}
 
 
-	if (m_buffers.size() > 0)
+	// Bound per instance they would be read at the packed instance index rather than the remapped one
+	if (GetBuffers().size() > 0 && m_remap_buffer == nullptr)
 	{
 		std::vector<VkBuffer> vertex_buffers;
-		for (auto buffer = m_buffers.begin(); buffer != m_buffers.end(); buffer++)
+		for (auto buffer = GetBuffers().begin(); buffer != GetBuffers().end(); buffer++)
 		{
 			vertex_buffers.push_back(buffer->second->GetBufferData(BufferSlot::Primary)->buffer);
 		}
-		vkCmdBindVertexBuffers(
-			command_buffer,
+		std::vector<VkDeviceSize> vertex_offsets(vertex_buffers.size(), 0);
+		state.BindVertexBuffers(
 			1,
 			(uint32_t)vertex_buffers.size(),
 			vertex_buffers.data(),
+			vertex_offsets.data()
+		);
+	}
+
+	if (m_remap_buffer != nullptr)
+	{
+		state.BindVertexBuffers(
+			1 + (uint32_t)GetBuffers().size(),
+			1,
+			&m_remap_buffer->GetBufferData(BufferSlot::Primary)->buffer,
 			offsets
 		);
 	}
-	
+}
 
+void Renderer::Vulkan::VulkanModelPool::AttachDraws(VkCommandBuffer & command_buffer)
+{
+	if (m_remap_buffer != nullptr)
+	{
+		// Every visible model is an instance of the one command
+		if (Indexed())
+		{
+			vkCmdDrawIndexedIndirect(
+				command_buffer,
+				m_remap_draw_buffer->GetBufferData(BufferSlot::Primary)->buffer,
+				0,
+				1,
+				sizeof(VkDrawIndexedIndirectCommand)
+			);
+		}
+		else
+		{
+			vkCmdDrawIndirect(
+				command_buffer,
+				m_remap_draw_buffer->GetBufferData(BufferSlot::Primary)->buffer,
+				0,
+				1,
+				sizeof(VkDrawIndirectCommand)
+			);
+		}
+		return;
+	}
+	if (UsesDrawCount())
+	{
+		// Recorded against the whole indirect buffer, the GPU stops at the current count
+		m_device->CmdDrawIndirectCount(
+			command_buffer,
+			Indexed(),
+			m_indirect_draw_buffer->GetBufferData(BufferSlot::Primary)->buffer,
+			m_draw_count_buffer->GetBufferData(BufferSlot::Primary)->buffer,
+			m_indirect_draw_buffer->GetElementCount(BufferSlot::Primary),
+			Indexed() ? sizeof(VkDrawIndexedIndirectCommand) : sizeof(VkDrawIndirectCommand)
+		);
+		return;
+	}
 	// Check to see if we can render all models in one draw pass
 	if (m_device->GetVulkanPhysicalDevice()->GetDeviceFeatures()->multiDrawIndirect &&
 		m_device->GetVulkanPhysicalDevice()->GetPhysicalDeviceProperties()->limits.maxDrawIndirectCount >= m_current_index)
@@ -284,6 +496,42 @@ void Renderer::Vulkan::VulkanModelPool::AttachToCommandBuffer(VkCommandBuffer &
 	
 }
 
+bool Renderer::Vulkan::VulkanModelPool::CanDrawWith(VulkanModelPool * other)
+{
+	// Remapped pools bind their own remap buffer
+	// Instance buffers come from the arena and each pool draws its own range of them, so they always match
+	return m_geometry_arena != nullptr &&
+		m_remap_buffer == nullptr && other->m_remap_buffer == nullptr &&
+		m_geometry_arena == other->m_geometry_arena &&
+		Indexed() == other->Indexed() &&
+		m_descriptor_sets == other->m_descriptor_sets;
+}
+
+unsigned int Renderer::Vulkan::VulkanModelPool::GetDrawCount()
+{
+	return m_current_index;
+}
+
+void Renderer::Vulkan::VulkanModelPool::GetDrawCommands(std::vector<VkDrawIndexedIndirectCommand>& commands)
+{
+	commands.insert(commands.end(), m_indexed_indirect_command.begin(), m_indexed_indirect_command.begin() + m_current_index);
+}
+
+void Renderer::Vulkan::VulkanModelPool::GetDrawCommands(std::vector<VkDrawIndirectCommand>& commands)
+{
+	commands.insert(commands.end(), m_vertex_indirect_command.begin(), m_vertex_indirect_command.begin() + m_current_index);
+}
+
+bool Renderer::Vulkan::VulkanModelPool::HaveDrawsChanged()
+{
+	if (m_draws_changed)
+	{
+		m_draws_changed = false;
+		return true;
+	}
+	return false;
+}
+
 bool Renderer::Vulkan::VulkanModelPool::HasChanged()
 {
 	if (m_change)
@@ -294,8 +542,16 @@ bool Renderer::Vulkan::VulkanModelPool::HasChanged()
 	return false;
 }
 
-void Renderer::Vulkan::VulkanModelPool::ResizeIndirectArray(unsigned int size)
+bool Renderer::Vulkan::VulkanModelPool::ResizeIndirectArray(unsigned int size)
 {
+	// Commands are never dropped
+	size = std::max(size, (unsigned int)(Indexed() ? m_indexed_indirect_command.size() : m_vertex_indirect_command.size()));
+	// Every command has an instance of its own in the arena buffers
+	if (m_geometry_arena != nullptr && !ReserveInstances(size))
+	{
+		// A new pool still gets its commands, none of them can draw until the range is reserved
+		if (m_indirect_draw_buffer != nullptr) return false;
+	}
 
 	unsigned int old_size;
 	unsigned int instance_size;
@@ -314,17 +570,24 @@ void Renderer::Vulkan::VulkanModelPool::ResizeIndirectArray(unsigned int size)
 	// If the buffer is not created, create it
 	if (m_indirect_draw_buffer == nullptr)
 	{
+		if (m_device->CanDrawIndirectCount(1))
+		{
+			m_draw_count_buffer = new VulkanBuffer(m_device, BufferChain::Single, &m_draw_count, sizeof(uint32_t), 1,
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			m_draw_count_buffer->SetData(BufferSlot::Primary);
+		}
 		if (Indexed())
 		{
 			// Set the data for the model pool
 			for (unsigned int i = 0; i < size; i++)
 			{
 				VkDrawIndexedIndirectCommand& indexed_indirect_command = m_indexed_indirect_command[i];
-				indexed_indirect_command.indexCount = GetIndexBuffer()->GetElementCount(BufferSlot::Primary);
+				indexed_indirect_command.indexCount = m_vertex_draw_count;
 				indexed_indirect_command.instanceCount = 0;
-				indexed_indirect_command.firstIndex = 0;
-				indexed_indirect_command.vertexOffset = 0;
-				indexed_indirect_command.firstInstance = i;
+				indexed_indirect_command.firstIndex = m_mesh.first_index;
+				indexed_indirect_command.vertexOffset = m_mesh.first_vertex;
+				indexed_indirect_command.firstInstance = m_first_instance + i;
 			}
 			// Create the vulkan buffer
 			m_indirect_draw_buffer = new VulkanBuffer(m_device, BufferChain::Single, m_indexed_indirect_command.data(), instance_size, size,
@@ -339,10 +602,10 @@ void Renderer::Vulkan::VulkanModelPool::ResizeIndirectArray(unsigned int size)
 			for (unsigned int i = 0; i < size; i++)
 			{
 				VkDrawIndirectCommand& vertex_indirect_command = m_vertex_indirect_command[i];
-				vertex_indirect_command.firstInstance = i;
-				vertex_indirect_command.firstVertex = 0;
+				vertex_indirect_command.firstInstance = m_first_instance + i;
+				vertex_indirect_command.firstVertex = m_mesh.first_vertex;
 				vertex_indirect_command.instanceCount = 0;
-				vertex_indirect_command.vertexCount = GetVertexBuffer()->GetElementCount(BufferSlot::Primary);
+				vertex_indirect_command.vertexCount = m_vertex_draw_count;
 			}
 			// Create the vulkan buffer
 			m_indirect_draw_buffer = new VulkanBuffer(m_device, BufferChain::Single, m_vertex_indirect_command.data(), instance_size, size,
@@ -355,16 +618,31 @@ void Renderer::Vulkan::VulkanModelPool::ResizeIndirectArray(unsigned int size)
 	}
 	else // Vulkan buffer already created
 	{
+		if (m_geometry_arena != nullptr)
+		{
+			// The instance range may have moved
+			for (unsigned int i = 0; i < old_size; i++)
+			{
+				if (Indexed())
+				{
+					m_indexed_indirect_command[i].firstInstance = m_first_instance + i;
+				}
+				else
+				{
+					m_vertex_indirect_command[i].firstInstance = m_first_instance + i;
+				}
+			}
+		}
 		if (Indexed())
 		{
 			for (unsigned int i = old_size; i < size; i++)
 			{
 				VkDrawIndexedIndirectCommand& indexed_indirect_command = m_indexed_indirect_command[i];
-				indexed_indirect_command.indexCount = GetIndexBuffer()->GetElementCount(BufferSlot::Primary);
+				indexed_indirect_command.indexCount = m_vertex_draw_count;
 				indexed_indirect_command.instanceCount = 0;
-				indexed_indirect_command.firstIndex = 0;
-				indexed_indirect_command.vertexOffset = 0;
-				indexed_indirect_command.firstInstance = i;
+				indexed_indirect_command.firstIndex = m_mesh.first_index;
+				indexed_indirect_command.vertexOffset = m_mesh.first_vertex;
+				indexed_indirect_command.firstInstance = m_first_instance + i;
 			}
 			m_indirect_draw_buffer->Resize(BufferSlot::Primary, m_indexed_indirect_command.data(), size);
 		}
@@ -373,16 +651,19 @@ void Renderer::Vulkan::VulkanModelPool::ResizeIndirectArray(unsigned int size)
 			for (unsigned int i = old_size; i < size; i++)
 			{
 				VkDrawIndirectCommand& vertex_indirect_command = m_vertex_indirect_command[i];
-				vertex_indirect_command.firstInstance = i;
-				vertex_indirect_command.firstVertex = 0;
+				vertex_indirect_command.firstInstance = m_first_instance + i;
+				vertex_indirect_command.firstVertex = m_mesh.first_vertex;
 				vertex_indirect_command.instanceCount = 0;
-				vertex_indirect_command.vertexCount = GetVertexBuffer()->GetElementCount(BufferSlot::Primary);
+				vertex_indirect_command.vertexCount = m_vertex_draw_count;
 			}
 			m_indirect_draw_buffer->Resize(BufferSlot::Primary, m_vertex_indirect_command.data(), size);
 		}
 		m_indirect_draw_buffer->SetData(BufferSlot::Primary);
+		// The recorded draws reference the old buffer
+		m_change = true;
 	}
 
+	return true;
 
 	/*
 	unsigned int instance_size;
@@ -470,11 +751,159 @@ void Renderer::Vulkan::VulkanModelPool::ResizeIndirectArray(unsigned int size)
 	}*/
 }
 
+void Renderer::Vulkan::VulkanModelPool::BeginBatch()
+{
+	m_batching = true;
+	m_dirty_commands = DirtyRange();
+	m_dirty_remap = DirtyRange();
+	m_remap_command_dirty = false;
+	m_draw_count_dirty = false;
+}
+
+void Renderer::Vulkan::VulkanModelPool::EndBatch()
+{
+	m_batching = false;
+	if (m_dirty_commands.end > m_dirty_commands.first)
+	{
+		m_indirect_draw_buffer->SetData(BufferSlot::Primary, m_dirty_commands.first, m_dirty_commands.end - m_dirty_commands.first);
+	}
+	if (m_remap_buffer != nullptr && m_dirty_remap.end > m_dirty_remap.first)
+	{
+		m_remap_buffer->SetData(BufferSlot::Primary, m_dirty_remap.first, m_dirty_remap.end - m_dirty_remap.first);
+	}
+	if (m_remap_buffer != nullptr && m_remap_command_dirty)
+	{
+		UpdateRemapCommand();
+	}
+	if (m_draw_count_buffer != nullptr && m_draw_count_dirty)
+	{
+		m_draw_count_buffer->SetData(BufferSlot::Primary);
+	}
+}
+
+void Renderer::Vulkan::VulkanModelPool::WriteElement(VulkanBuffer * buffer, DirtyRange & range, unsigned int index)
+{
+	if (!m_batching)
+	{
+		buffer->SetData(BufferSlot::Primary, index, 1);
+		return;
+	}
+	if (range.end == range.first)
+	{
+		range.first = index;
+		range.end = index + 1;
+		return;
+	}
+	range.first = std::min(range.first, index);
+	range.end = std::max(range.end, index + 1);
+}
+
+void Renderer::Vulkan::VulkanModelPool::UpdateModelBufferTable()
+{
+	m_model_buffers.clear();
+	for (auto buffer = GetBuffers().begin(); buffer != GetBuffers().end(); buffer++)
+	{
+		ModelBuffer model_buffer;
+		model_buffer.index = buffer->first;
+		model_buffer.index_size = buffer->second->GetIndexSize(BufferSlot::Primary);
+		model_buffer.data = (char*)buffer->second->GetDataPointer(BufferSlot::Primary) + model_buffer.index_size * m_first_instance;
+		m_model_buffers.push_back(model_buffer);
+	}
+}
+
+std::map<unsigned int, Renderer::Vulkan::VulkanUniformBuffer*>& Renderer::Vulkan::VulkanModelPool::GetBuffers()
+{
+	if (m_geometry_arena != nullptr) return m_geometry_arena->GetBuffers();
+	return m_buffers;
+}
+
+bool Renderer::Vulkan::VulkanModelPool::ReserveInstances(unsigned int size)
+{
+	if (size <= m_instance_count) return true;
+	unsigned int first;
+	if (!m_geometry_arena->AllocateInstances(size, first)) return false;
+	unsigned int old_first = m_first_instance;
+	unsigned int old_count = m_instance_count;
+	m_first_instance = first;
+	m_instance_count = size;
+	if (old_count == 0) return true;
+	// Carry the existing instance data over, the old range is only reused once the frames reading it are done
+	for (auto buffer = GetBuffers().begin(); buffer != GetBuffers().end(); buffer++)
+	{
+		char* data = (char*)buffer->second->GetDataPointer(BufferSlot::Primary);
+		unsigned int index_size = buffer->second->GetIndexSize(BufferSlot::Primary);
+		memcpy(data + (size_t)index_size * m_first_instance, data + (size_t)index_size * old_first, (size_t)index_size * old_count);
+		buffer->second->SetData(BufferSlot::Primary, m_first_instance, old_count);
+		UpdateModelBuffer(buffer->first);
+	}
+	m_geometry_arena->ReleaseInstances(old_first, old_count);
+	UpdateModelBufferTable();
+	// The remap holds instance indices rather than model indices
+	if (m_remap_buffer != nullptr)
+	{
+		for (unsigned int i = 0; i < m_visible_count; i++)
+		{
+			m_remap[i] = m_remap[i] - old_first + m_first_instance;
+		}
+		m_remap_buffer->SetData(BufferSlot::Primary);
+	}
+	return true;
+}
+
+Renderer::Vulkan::VulkanModel * Renderer::Vulkan::VulkanModelPool::AddModel()
+{
+	// Freed slots are reused first, so the indices stay as packed as the models do
+	VulkanSlotHandle handle = m_models.Insert(nullptr);
+	unsigned int new_index = handle.index;
+	// Make room for the models command, and its instance when drawing from an arena
+	if (new_index + 1 >= m_indirect_draw_buffer->GetElementCount(BufferSlot::Primary) ||
+		(m_geometry_arena != nullptr && new_index >= m_instance_count))
+	{
+		if (!ResizeIndirectArray(new_index + m_indirect_array_padding))
+		{
+			m_models.Remove(handle);
+			return nullptr;
+		}
+	}
+	if (new_index >= m_current_index)
+	{
+		m_current_index = new_index + 1;
+		m_largest_index = m_current_index;
+		if (m_draw_count_buffer != nullptr)
+		{
+			m_draw_count = m_current_index;
+			if (m_batching)
+			{
+				m_draw_count_dirty = true;
+			}
+			else
+			{
+				m_draw_count_buffer->SetData(BufferSlot::Primary);
+			}
+		}
+	}
+
+	VulkanModel* model = new VulkanModel(this, handle);
+	*m_models.Get(handle) = model;
+	for (auto& buffer : m_model_buffers)
+	{
+		model->SetDataPointer(buffer.index, buffer.data + buffer.index_size * new_index);
+	}
+	model->ShouldRender(true);
+	return model;
+}
+
+bool Renderer::Vulkan::VulkanModelPool::UsesDrawCount()
+{
+	return m_draw_count_buffer != nullptr && m_device->CanDrawIndirectCount(m_indirect_draw_buffer->GetElementCount(BufferSlot::Primary));
+}
+
 void Renderer::Vulkan::VulkanModelPool::Render(unsigned int index, bool should_render)
 {
-	if (index + 1 >= m_indirect_draw_buffer->GetElementCount(BufferSlot::Primary))
+	// AddModel makes room for every model, so this only fails if that was skipped
+	if (index + 1 >= m_indirect_draw_buffer->GetElementCount(BufferSlot::Primary) && !ResizeIndirectArray(index + m_indirect_array_padding))
 	{
-		ResizeIndirectArray(index + m_indirect_array_padding);
+		return;
 	}
 
 	if (Indexed())
@@ -488,6 +917,68 @@ void Renderer::Vulkan::VulkanModelPool::Render(unsigned int index, bool should_r
 		vertex_indirect_command.instanceCount = (should_render ? 1 : 0);
 	}
 
-	m_indirect_draw_buffer->SetData(BufferSlot::Primary,index, 1);
+	WriteElement(m_indirect_draw_buffer, m_dirty_commands, index);
+	m_draws_changed = true;
+
+	if (m_remap_buffer != nullptr)
+	{
+		UpdateInstanceRemap(index, should_render);
+	}
+}
+
+void Renderer::Vulkan::VulkanModelPool::UpdateInstanceRemap(unsigned int index, bool visible)
+{
+	if (index >= m_remap_positions.size())
+	{
+		m_remap_positions.resize(index + m_indirect_array_padding, m_remap_hidden);
+	}
+	unsigned int position = m_remap_positions[index];
+	if (visible == (position != m_remap_hidden)) return;
+	if (visible)
+	{
+		ReserveRemap(m_visible_count + 1);
+		m_remap[m_visible_count] = m_first_instance + index;
+		m_remap_positions[index] = m_visible_count;
+		WriteElement(m_remap_buffer, m_dirty_remap, m_visible_count);
+		m_visible_count++;
+	}
+	else
+	{
+		// Move the last visible model into the gap so the list stays packed
+		m_visible_count--;
+		unsigned int last = m_remap[m_visible_count] - m_first_instance;
+		m_remap[position] = m_remap[m_visible_count];
+		m_remap_positions[last] = position;
+		m_remap_positions[index] = m_remap_hidden;
+		if (position < m_visible_count)
+		{
+			WriteElement(m_remap_buffer, m_dirty_remap, position);
+		}
+	}
+	UpdateRemapCommand();
+}
+
+void Renderer::Vulkan::VulkanModelPool::ReserveRemap(unsigned int size)
+{
+	if (size <= m_remap.size()) return;
+	// The buffer is replaced, so the recorded bindings have to be recorded again
+	m_remap.resize(size + m_indirect_array_padding, 0);
+	m_remap_buffer->Resize(BufferSlot::Primary, m_remap.data(), (unsigned int)m_remap.size());
+	m_remap_buffer->SetData(BufferSlot::Primary);
+	m_change = true;
+}
+
+void Renderer::Vulkan::VulkanModelPool::UpdateRemapCommand()
+{
+	if (m_batching)
+	{
+		m_remap_command_dirty = true;
+		return;
+	}
+	m_remap_indexed_command.indexCount = m_vertex_draw_count;
+	m_remap_indexed_command.instanceCount = m_visible_count;
+	m_remap_vertex_command.vertexCount = m_vertex_draw_count;
+	m_remap_vertex_command.instanceCount = m_visible_count;
+	m_remap_draw_buffer->SetData(BufferSlot::Primary);
 }
 
@@ -2,9 +2,10 @@
 #include <renderer/vulkan/VulkanInstance.hpp>
 
 #include <set>
+#include <cstring>
 #include <assert.h>
 
-Renderer::Vulkan::VulkanPhysicalDevice::VulkanPhysicalDevice(VkPhysicalDevice device, VulkanQueueFamilyIndices queue_family)
+Renderer::Vulkan::VulkanPhysicalDevice::VulkanPhysicalDevice(VulkanInstance* instance, VkPhysicalDevice device, VulkanQueueFamilyIndices queue_family)
 {
 	m_device = device;
 	m_queue_family = queue_family;
@@ -26,6 +27,22 @@ Renderer::Vulkan::VulkanPhysicalDevice::VulkanPhysicalDevice(VkPhysicalDevice de
 		&m_physical_device_mem_properties
 	);
 	m_device_extensions = GetDeviceExtenstions();
+
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(m_device, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> available_extensions(extension_count);
+	vkEnumerateDeviceExtensionProperties(m_device, nullptr, &extension_count, available_extensions.data());
+	for (const char* extension : GetOptionalDeviceExtensions(instance))
+	{
+		for (const auto& available_extension : available_extensions)
+		{
+			if (strcmp(extension, available_extension.extensionName) == 0)
+			{
+				m_device_extensions.push_back(extension);
+				break;
+			}
+		}
+	}
 }
 
 VkPhysicalDevice * Renderer::Vulkan::VulkanPhysicalDevice::GetPhysicalDevice()
@@ -58,6 +75,15 @@ std::vector<const char*>* Renderer::Vulkan::VulkanPhysicalDevice::GetExtenstions
 	return &m_device_extensions;
 }
 
+bool Renderer::Vulkan::VulkanPhysicalDevice::HasExtension(const char * extension_name)
+{
+	for (const char* extension : m_device_extensions)
+	{
+		if (strcmp(extension, extension_name) == 0) return true;
+	}
+	return false;
+}
+
 VkFormatProperties Renderer::Vulkan::VulkanPhysicalDevice::GetFormatProperties(VkFormat format)
 {
 	VkFormatProperties format_properties;
@@ -93,7 +119,7 @@ Renderer::Vulkan::VulkanPhysicalDevice * Renderer::Vulkan::VulkanPhysicalDevice:
 	}
 
 	assert(chosen_device != VK_NULL_HANDLE && "No suitable device");
-	device_instance = new VulkanPhysicalDevice(chosen_device, chosen_queue_family);
+	device_instance = new VulkanPhysicalDevice(instance, chosen_device, chosen_queue_family);
 	return device_instance;
 }
 
@@ -127,6 +153,29 @@ std::vector<const char*> Renderer::Vulkan::VulkanPhysicalDevice::GetDeviceExtens
 	};
 }
 
+std::vector<const char*> Renderer::Vulkan::VulkanPhysicalDevice::GetOptionalDeviceExtensions(VulkanInstance * instance)
+{
+	std::vector<const char*> extensions;
+#ifdef VK_EXT_memory_budget
+	// The budget is read through vkGetPhysicalDeviceMemoryProperties2KHR
+	if (instance->HasExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+	{
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+#endif
+#ifdef VK_KHR_timeline_semaphore
+	// Depends on VK_KHR_get_physical_device_properties2 as well
+	if (instance->HasExtension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+	{
+		extensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+	}
+#endif
+#ifdef VK_KHR_draw_indirect_count
+	extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+#endif
+	return extensions;
+}
+
 bool Renderer::Vulkan::VulkanPhysicalDevice::CheckPhysicalDevice(VkPhysicalDevice & device)
 {
 	bool supportsExtentions = CheckDeviceExtensionSupport(device);
@@ -163,28 +212,50 @@ bool Renderer::Vulkan::VulkanPhysicalDevice::SupportsQueueFamily(VulkanInstance
 	// Get queue families
 	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, queue_families.data());
+
+	queue_family_indices = VulkanQueueFamilyIndices();
 	// Loop through and choose right family
-	uint32_t i = 0;
-	for (const auto& queue_family : queue_families)
+	for (uint32_t i = 0; i < queue_family_count; i++)
 	{
-		if (queue_family.queueCount > 0)
-		{
-			queue_family_indices.graphics_indices = i;
-			queue_family_indices.compute_indices = i;
+		const VkQueueFamilyProperties& queue_family = queue_families[i];
+		if (queue_family.queueCount == 0) continue;
 
-			VkBool32 present_support = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(
-				device,
-				i,
-				surface,
-				&present_support
-			);
-			if (present_support)
-				queue_family_indices.present_indices = i;
+		VkBool32 present_support = false;
+		vkGetPhysicalDeviceSurfaceSupportKHR(
+			device,
+			i,
+			surface,
+			&present_support
+		);
+
+		if (queue_family.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		{
+			// Prefer a graphics family that can also present so we do not need to share the swapchain images
+			if (queue_family_indices.graphics_indices == UINT32_MAX ||
+				(present_support && queue_family_indices.present_indices != queue_family_indices.graphics_indices))
+			{
+				queue_family_indices.graphics_indices = i;
+				// Compute work shares buffers with rendering, so keep it on the graphics family
+				queue_family_indices.compute_indices = i;
+				if (present_support) queue_family_indices.present_indices = i;
+			}
+		}
+		if (present_support && queue_family_indices.present_indices == UINT32_MAX)
+		{
+			queue_family_indices.present_indices = i;
+		}
+		// A family that can only transfer is normally backed by a DMA engine that runs alongside rendering
+		if ((queue_family.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+			!(queue_family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+			queue_family_indices.transfer_indices == UINT32_MAX)
+		{
+			queue_family_indices.transfer_indices = i;
 		}
-		// Graphics return
-		if (queue_family_indices.isComplete()) return true;
-		i++;
 	}
-	return false;
+	// Fall back to uploading on the graphics queue
+	if (queue_family_indices.transfer_indices == UINT32_MAX)
+	{
+		queue_family_indices.transfer_indices = queue_family_indices.graphics_indices;
+	}
+	return queue_family_indices.isComplete();
 }
@@ -24,6 +24,7 @@ void Renderer::Vulkan::VulkanPipeline::AttachDescriptorPool(IDescriptorPool * bu
 void Renderer::Vulkan::VulkanPipeline::AttachDescriptorSet(unsigned int setID, IDescriptorSet* descriptor_set)
 {
 	m_descriptor_sets[setID] = static_cast<VulkanDescriptorSet*>(descriptor_set);
+	m_device->MarkSceneChanged();
 }
 
 bool Renderer::Vulkan::VulkanPipeline::Build()
@@ -1,5 +1,6 @@
 #include <renderer/vulkan/VulkanRenderer.hpp>
 #include <renderer/vulkan/VulkanInstance.hpp>
+#include <renderer/vulkan/VulkanHostAllocator.hpp>
 #include <renderer/vulkan/VulkanPhysicalDevice.hpp>
 #include <renderer/vulkan/VulkanDevice.hpp>
 #include <renderer/vulkan/VulkanSwapchain.hpp>
@@ -10,6 +11,7 @@
 #include <renderer\vulkan\VulkanGraphicsPipeline.hpp>
 #include <renderer\vulkan\VulkanComputeProgram.hpp>
 #include <renderer\vulkan\VulkanModelPool.hpp>
+#include <renderer\vulkan\VulkanGeometryArena.hpp>
 #include <renderer\vulkan\VulkanTextureBuffer.hpp>
 #include <renderer\vulkan\VulkanDescriptor.hpp>
 #include <renderer\vulkan\VulkanDescriptorPool.hpp>
@@ -29,7 +31,7 @@ VulkanRenderer::~VulkanRenderer()
 	Stop();
 }
 
-bool VulkanRenderer::Start(Renderer::NativeWindowHandle* window_handle)
+bool VulkanRenderer::Start(Renderer::NativeWindowHandle* window_handle, Renderer::SwapchainConfiguration configuration)
 {
 	m_window_handle = window_handle;
 
@@ -47,7 +49,7 @@ bool VulkanRenderer::Start(Renderer::NativeWindowHandle* window_handle)
 	Status::ErrorCheck(m_device);
 	if (HasError())return false;
 
-	m_swapchain = new VulkanSwapchain(m_instance, m_device, &m_surface, window_handle);
+	m_swapchain = new VulkanSwapchain(m_instance, m_device, &m_surface, window_handle, configuration);
 	Status::ErrorCheck(m_swapchain);
 	if (HasError())return false;
 
@@ -59,6 +61,14 @@ bool VulkanRenderer::Start(Renderer::NativeWindowHandle* window_handle)
 void VulkanRenderer::Update()
 {
 	if (!m_running)return;
+	// Destroy anything the GPU has finished with
+	m_device->RetireFrames();
+	// Make this frames host writes visible before anything is submitted
+	m_device->FlushMappedRanges();
+	// Uploads go ahead of the frame on the same queue so the frame sees the new data
+	m_device->SubmitUploads();
+	// Nothing changed, so the last presented frame is still correct
+	if (!ShouldDrawFrame()) return;
 	unsigned int currentBuffer = m_swapchain->GetCurrentBuffer();
 
 	m_swapchain->SubmitQueue(currentBuffer);
@@ -68,6 +78,7 @@ void VulkanRenderer::Update()
 	};
 
 	m_swapchain->Present(signal_semaphores);
+	m_last_frame_time = std::chrono::steady_clock::now();
 }
 
 void VulkanRenderer::Stop()
@@ -82,22 +93,32 @@ void VulkanRenderer::Stop()
 
 void Renderer::Vulkan::VulkanRenderer::Rebuild()
 {
-	m_swapchain->RebuildSwapchain();
+	m_swapchain->RequestRebuildSwapchain();
 }
 
-IUniformBuffer * Renderer::Vulkan::VulkanRenderer::CreateUniformBuffer(void * dataPtr, BufferChain level, unsigned int indexSize, unsigned int elementCount, bool modifiable)
+void Renderer::Vulkan::VulkanRenderer::SetMaxIdleInterval(unsigned int milliseconds)
 {
-	return new VulkanUniformBuffer(m_device, level, dataPtr, indexSize, elementCount, modifiable);
+	m_max_idle_interval = milliseconds;
 }
 
-IVertexBuffer * Renderer::Vulkan::VulkanRenderer::CreateVertexBuffer(void * dataPtr, unsigned int indexSize, unsigned int elementCount)
+void Renderer::Vulkan::VulkanRenderer::RequestRedraw()
 {
-	return new VulkanVertexBuffer(m_device,  dataPtr, indexSize, elementCount);
+	m_redraw_requested = true;
 }
 
-IIndexBuffer * Renderer::Vulkan::VulkanRenderer::CreateIndexBuffer(void * dataPtr, unsigned int indexSize, unsigned int elementCount)
+IUniformBuffer * Renderer::Vulkan::VulkanRenderer::CreateUniformBuffer(void * dataPtr, BufferChain level, unsigned int indexSize, unsigned int elementCount, bool modifiable, BufferUsageHint usage)
 {
-	return new VulkanIndexBuffer(m_device, dataPtr, indexSize, elementCount);
+	return new VulkanUniformBuffer(m_device, level, dataPtr, indexSize, elementCount, modifiable, usage);
+}
+
+IVertexBuffer * Renderer::Vulkan::VulkanRenderer::CreateVertexBuffer(void * dataPtr, unsigned int indexSize, unsigned int elementCount, BufferUsageHint usage)
+{
+	return new VulkanVertexBuffer(m_device, dataPtr, indexSize, elementCount, usage);
+}
+
+IIndexBuffer * Renderer::Vulkan::VulkanRenderer::CreateIndexBuffer(void * dataPtr, unsigned int indexSize, unsigned int elementCount, BufferUsageHint usage)
+{
+	return new VulkanIndexBuffer(m_device, dataPtr, indexSize, elementCount, usage);
 }
 
 IGraphicsPipeline * Renderer::Vulkan::VulkanRenderer::CreateGraphicsPipeline(std::map<ShaderStage, const char*> paths, bool priority)
@@ -132,6 +153,16 @@ IModelPool * Renderer::Vulkan::VulkanRenderer::CreateModelPool(IVertexBuffer * v
 	return new VulkanModelPool(m_device, vertex_buffer);
 }
 
+IGeometryArena * Renderer::Vulkan::VulkanRenderer::CreateGeometryArena(unsigned int vertex_size, unsigned int vertex_capacity, unsigned int index_capacity, unsigned int instance_capacity)
+{
+	return new VulkanGeometryArena(m_device, vertex_size, vertex_capacity, index_capacity, instance_capacity);
+}
+
+IModelPool * Renderer::Vulkan::VulkanRenderer::CreateModelPool(IGeometryArena * geometry_arena, MeshRange mesh)
+{
+	return new VulkanModelPool(m_device, static_cast<VulkanGeometryArena*>(geometry_arena), mesh);
+}
+
 ITextureBuffer * Renderer::Vulkan::VulkanRenderer::CreateTextureBuffer(void * dataPtr, DataFormat format, unsigned int width, unsigned int height)
 {
 	return new VulkanTextureBuffer(m_device, dataPtr, format, width, height);
@@ -147,6 +178,67 @@ IDescriptorPool * Renderer::Vulkan::VulkanRenderer::CreateDescriptorPool(std::ve
 	return new VulkanDescriptorPool(m_device, descriptors);
 }
 
+UploadHandle Renderer::Vulkan::VulkanRenderer::SubmitUploads()
+{
+	return m_device->SubmitUploads();
+}
+
+bool Renderer::Vulkan::VulkanRenderer::IsUploadComplete(UploadHandle handle)
+{
+	return m_device->IsUploadComplete(handle);
+}
+
+void Renderer::Vulkan::VulkanRenderer::WaitForUpload(UploadHandle handle)
+{
+	m_device->WaitForUpload(handle);
+}
+
+MemoryStats Renderer::Vulkan::VulkanRenderer::GetMemoryStats()
+{
+	MemoryStats stats;
+	m_device->GetMemoryStats(stats);
+	return stats;
+}
+
+HostMemoryStats Renderer::Vulkan::VulkanRenderer::GetHostMemoryStats()
+{
+	HostMemoryStats stats;
+	m_instance->GetHostAllocator()->GetHostMemoryStats(stats);
+	return stats;
+}
+
+CommandStats Renderer::Vulkan::VulkanRenderer::GetCommandStats()
+{
+	CommandStats stats;
+	m_device->GetCommandStats(stats);
+	return stats;
+}
+
+float Renderer::Vulkan::VulkanRenderer::GetResolutionScale()
+{
+	return m_swapchain->GetResolutionScale();
+}
+
+bool Renderer::Vulkan::VulkanRenderer::ShouldDrawFrame()
+{
+	// Always clear the change flag so changes made while idle are not counted twice
+	bool draw = m_device->CheckSceneChanged() || m_redraw_requested || m_max_idle_interval == 0;
+	// Latched data is written by a callback the renderer can not see into, so compare it with what was last drawn
+	for (auto latch : m_device->GetLateLatches())
+	{
+		if (draw) break;
+		draw = latch->HasLateLatchChanged();
+	}
+	if (!draw)
+	{
+		if (m_max_idle_interval == NO_IDLE_LIMIT) return false;
+		std::chrono::steady_clock::duration idle = std::chrono::steady_clock::now() - m_last_frame_time;
+		if (idle < std::chrono::milliseconds(m_max_idle_interval)) return false;
+	}
+	m_redraw_requested = false;
+	return true;
+}
+
 VkDescriptorType Renderer::Vulkan::VulkanRenderer::ToDescriptorType(DescriptorType descriptor_type)
 {
 	switch (descriptor_type)
@@ -183,7 +275,7 @@ void Renderer::Vulkan::VulkanRenderer::CreateSurface(Renderer::NativeWindowHandl
 
 	VkWin32SurfaceCreateInfoKHR createInfo = VulkanInitializers::SurfaceCreateInfo(window_handle);
 
-	if (!CreateWin32SurfaceKHR || CreateWin32SurfaceKHR(*m_instance->GetInstance(), &createInfo, nullptr, &m_surface) != VK_SUCCESS)
+	if (!CreateWin32SurfaceKHR || CreateWin32SurfaceKHR(*m_instance->GetInstance(), &createInfo, m_instance->GetAllocationCallbacks(), &m_surface) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to create window surface!");
 	}
@@ -0,0 +1,82 @@
+#include <renderer/vulkan/VulkanStagingRing.hpp>
+#include <renderer/vulkan/VulkanDevice.hpp>
+#include <renderer/vulkan/VulkanCommon.hpp>
+
+#include <assert.h>
+
+// Keep copies on 16 byte boundaries so any vertex, index or texel format can be sourced from the ring
+const VkDeviceSize Renderer::Vulkan::VulkanStagingRing::m_alignment = 16;
+
+Renderer::Vulkan::VulkanStagingRing::VulkanStagingRing(VulkanDevice * device, VkDeviceSize size)
+{
+	m_device = device;
+	VulkanCommon::CreateBuffer(
+		m_device,
+		size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_ring_buffer
+	);
+	VulkanCommon::MapBufferMemory(m_device, m_ring_buffer, size);
+	m_size = size;
+	m_head = 0;
+	m_used = 0;
+	m_front_region = 0;
+}
+
+Renderer::Vulkan::VulkanStagingRing::~VulkanStagingRing()
+{
+	VulkanCommon::UnMapBufferMemory(m_device, m_ring_buffer);
+	VulkanCommon::DestroyBuffer(m_device, m_ring_buffer);
+}
+
+bool Renderer::Vulkan::VulkanStagingRing::Allocate(VkDeviceSize size, VkDeviceSize & offset, uint64_t & region)
+{
+	if (size > m_size) return false;
+	if (m_used == 0) m_head = 0;
+
+	VkDeviceSize start = (m_head + m_alignment - 1) & ~(m_alignment - 1);
+	VkDeviceSize needed = (start - m_head) + size;
+	// Wrap around to the start, the tail end of the ring is counted as used until this region is released
+	if (start + size > m_size)
+	{
+		start = 0;
+		needed = (m_size - m_head) + size;
+	}
+	if (m_used + needed > m_size) return false;
+
+	m_head = start + size;
+	m_used += needed;
+	offset = start;
+	region = m_front_region + m_regions.size();
+	m_regions.push_back({ needed, false });
+	return true;
+}
+
+void Renderer::Vulkan::VulkanStagingRing::Release(uint64_t region)
+{
+	assert(region >= m_front_region && region < m_front_region + m_regions.size() && "Unknown staging region");
+	m_regions[(size_t)(region - m_front_region)].released = true;
+	// Only move the tail forward once everything before it has been released too
+	while (!m_regions.empty() && m_regions.front().released)
+	{
+		m_used -= m_regions.front().bytes;
+		m_regions.pop_front();
+		m_front_region++;
+	}
+}
+
+void * Renderer::Vulkan::VulkanStagingRing::GetMappedMemory(VkDeviceSize offset)
+{
+	return ((char*)m_ring_buffer.mapped_memory) + offset;
+}
+
+VkBuffer Renderer::Vulkan::VulkanStagingRing::GetBuffer()
+{
+	return m_ring_buffer.buffer;
+}
+
+VkDeviceSize Renderer::Vulkan::VulkanStagingRing::GetSize()
+{
+	return m_size;
+}
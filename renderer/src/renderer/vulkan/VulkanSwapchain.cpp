@@ -5,16 +5,34 @@
 #include <renderer/vulkan/VulkanInitializers.hpp>
 #include <renderer/vulkan/VulkanCommon.hpp>
 #include <renderer/vulkan/VulkanGraphicsPipeline.hpp>
+#include <renderer/vulkan/VulkanUniformBuffer.hpp>
+#include <renderer/vulkan/VulkanThreadPool.hpp>
 
 #include <assert.h>
+#include <algorithm>
+#include <math.h>
 
-Renderer::Vulkan::VulkanSwapchain::VulkanSwapchain(VulkanInstance * instance, VulkanDevice * device, VkSurfaceKHR* surface, Renderer::NativeWindowHandle* window_handle)
+const unsigned int Renderer::Vulkan::VulkanSwapchain::m_max_frames_in_flight = 3;
+const float Renderer::Vulkan::VulkanSwapchain::m_resolution_scale_step = 0.05f;
+
+Renderer::Vulkan::VulkanSwapchain::VulkanSwapchain(VulkanInstance * instance, VulkanDevice * device, VkSurfaceKHR* surface, Renderer::NativeWindowHandle* window_handle, Renderer::SwapchainConfiguration configuration)
 {
+	// Each frame slot waits for the last frame that used it, so the slot count is the most frames queued ahead of the GPU
+	if (configuration.max_frame_latency == 0) configuration.max_frame_latency = 1;
+	if (configuration.max_frame_latency > m_max_frames_in_flight) configuration.max_frame_latency = m_max_frames_in_flight;
+	// Out of range values are clamped, see SwapchainConfiguration
+	configuration.max_resolution_scale = std::min(std::max(configuration.max_resolution_scale, m_resolution_scale_step), 1.0f);
+	configuration.min_resolution_scale = std::min(std::max(configuration.min_resolution_scale, m_resolution_scale_step), configuration.max_resolution_scale);
+	m_configuration = configuration;
+	m_resolution_scale = m_configuration.max_resolution_scale;
+	m_applied_resolution_scale = m_configuration.max_resolution_scale;
+	m_frames.resize(m_configuration.max_frame_latency);
 	m_instance = instance;
 	m_device = device;
 	m_surface = surface;
 	m_window_handle = window_handle;
 
+	m_recording_threads = new VulkanThreadPool(VulkanThreadPool::GetDefaultThreadCount());
 	CreateSwapchain();
 	InitCommandBuffers();
 	InitSemaphores();
@@ -24,46 +42,111 @@ Renderer::Vulkan::VulkanSwapchain::VulkanSwapchain(VulkanInstance * instance, Vu
 
 Renderer::Vulkan::VulkanSwapchain::~VulkanSwapchain()
 {
+	// Frames in flight still use the framebuffers and semaphores
+	m_device->RetireFrames(true);
 	DeInitSemaphores();
 	DestroySwapchain();
 	delete m_wait_stages;
+	delete m_recording_threads;
 }
 
 void Renderer::Vulkan::VulkanSwapchain::RequestRebuildCommandBuffers()
 {
 	m_should_rebuild_cmd = true;
+	m_device->MarkSceneChanged();
+}
+
+void Renderer::Vulkan::VulkanSwapchain::RequestRebuildSwapchain()
+{
+	m_should_rebuild_swapchain = true;
+	m_device->MarkSceneChanged();
 }
 
 void Renderer::Vulkan::VulkanSwapchain::RebuildSwapchain()
 {
-	vkDeviceWaitIdle(*m_device->GetVulkanDevice());
-	DestroySwapchain();
+	m_should_rebuild_swapchain = false;
+	VkFormat old_format = m_swap_chain_image_format;
+	VkSwapchainKHR old_swap_chain = m_swap_chain;
 
-	CreateSwapchain();
+	// The old swapchain is passed to the new one so the present engine can reuse its resources
+	InitSwapchain();
+	RetireSwapchain(old_swap_chain);
+	InitSwapchainImages();
+	if (m_swap_chain_image_format != old_format)
+	{
+		// Pipelines are only compatible with render passes of the same format, so they are built again against the new one
+		VkDevice device = *m_device->GetVulkanDevice();
+		const VkAllocationCallbacks* allocator = m_device->GetAllocationCallbacks();
+		VkRenderPass render_pass = m_render_pass;
+		m_device->DeferDestroy([device, allocator, render_pass]()
+		{
+			vkDestroyRenderPass(device, render_pass, allocator);
+		});
+		InitRenderPass();
+		for (auto pipeline : m_pipelines)
+		{
+			pipeline->Rebuild();
+		}
+	}
+	InitDepthImage();
+	InitFrameBuffer();
+	DeInitOffscreenTarget();
+	InitOffscreenTarget();
+	// Cached pipeline draws reference the old framebuffers and viewport
+	for (auto pipeline : m_pipelines)
+	{
+		pipeline->ReleaseCommandBuffers();
+	}
+
+	if (m_command_buffers.size() != m_swap_chain_framebuffers.size())
+	{
+		VkDevice device = *m_device->GetVulkanDevice();
+		VkCommandPool command_pool = *m_device->GetGraphicsCommandPool();
+		std::vector<VkCommandBuffer> command_buffers = m_command_buffers;
+		m_device->DeferDestroy([device, command_pool, command_buffers]()
+		{
+			vkFreeCommandBuffers(device, command_pool, (uint32_t)command_buffers.size(), command_buffers.data());
+		});
+		InitCommandBuffers();
+		m_image_frames.assign(m_command_buffers.size(), 0);
+	}
 
-	// Build initial command buffers
+	// The framebuffers changed, so every command buffer is recorded again before it is next used
 	RebuildCommandBuffers();
 }
 
 unsigned int Renderer::Vulkan::VulkanSwapchain::GetCurrentBuffer()
 {
+	FrameSync& frame = m_frames[m_current_frame];
+	// The semaphores of this frame are free again once the last frame that used them has finished
+	m_device->WaitForFrame(frame.serial);
+	if (m_should_rebuild_swapchain)
+	{
+		RebuildSwapchain();
+	}
 	if (m_should_rebuild_cmd)
 	{
 		m_should_rebuild_cmd = false;
 		RebuildCommandBuffers();
 	}
+	// Changed pipelines record their own draws again, the primary buffers only need to execute the new ones
+	bool pipelines_changed = false;
 	for (auto pipeline : m_pipelines)
 	{
 		if (pipeline->HasChanged())
 		{
-			RebuildCommandBuffers();
+			pipelines_changed = true;
 		}
 	}
+	if (pipelines_changed)
+	{
+		RebuildCommandBuffers();
+	}
 	VkResult check = vkAcquireNextImageKHR(
 		*m_device->GetVulkanDevice(),
 		m_swap_chain,
 		UINT32_MAX,
-		m_image_available_semaphore,
+		frame.image_available,
 		VK_NULL_HANDLE,
 		&m_active_swapchain_image
 	);
@@ -72,11 +155,22 @@ unsigned int Renderer::Vulkan::VulkanSwapchain::GetCurrentBuffer()
 		RebuildSwapchain();
 		return GetCurrentBuffer();
 	}
+	if (check == VK_SUBOPTIMAL_KHR)
+	{
+		// The image can still be presented, so rebuild once this frame is out of the way
+		RequestRebuildSwapchain();
+		check = VK_SUCCESS;
+	}
 	ErrorCheck(check);
 	assert(!HasError());
-	vkQueueWaitIdle(
-		*m_device->GetPresentQueue()
-	);
+	// The images command buffer may still be executing for an older frame
+	m_device->WaitForFrame(m_image_frames[m_active_swapchain_image]);
+	UpdateResolutionScale(m_active_swapchain_image);
+	if (m_dirty_command_buffers[m_active_swapchain_image])
+	{
+		RecordCommandBuffer(m_active_swapchain_image);
+		m_dirty_command_buffers[m_active_swapchain_image] = false;
+	}
 	return m_active_swapchain_image;
 }
 
@@ -85,26 +179,34 @@ VkSubmitInfo Renderer::Vulkan::VulkanSwapchain::GetSubmitInfo()
 	VkSubmitInfo sumbit_info = {};
 	sumbit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	sumbit_info.waitSemaphoreCount = 1;
-	sumbit_info.pWaitSemaphores = &m_image_available_semaphore;
+	sumbit_info.pWaitSemaphores = &m_frames[m_current_frame].image_available;
 	sumbit_info.pWaitDstStageMask = m_wait_stages;
 	sumbit_info.commandBufferCount = 1;
 	sumbit_info.signalSemaphoreCount = 1;
-	sumbit_info.pSignalSemaphores = &m_render_finished_semaphore;
+	sumbit_info.pSignalSemaphores = &m_frames[m_current_frame].render_finished;
 	return sumbit_info;
 }
 
 void Renderer::Vulkan::VulkanSwapchain::SubmitQueue(unsigned int currentBuffer)
 {
-	VkSubmitInfo info = GetSubmitInfo();
-	info.pCommandBuffers = &m_command_buffers[currentBuffer];
-	ErrorCheck(vkQueueSubmit(
-		*m_device->GetGraphicsQueue(),
-		1,
-		&info,
-		VK_NULL_HANDLE
-	));
-
-	assert(!HasError());
+	VulkanSubmission submission;
+	// Latched data is gathered as late as possible so the frame sees the newest input
+	if (RecordLateLatches())
+	{
+		submission.command_buffers.push_back(m_frames[m_current_frame].latch_commands);
+	}
+	submission.command_buffers.push_back(m_command_buffers[currentBuffer]);
+	submission.wait_semaphores.push_back(m_frames[m_current_frame].image_available);
+	// With dynamic resolution the image is first written by the blit rather than the render pass
+	submission.wait_semaphore_stages.push_back(m_dynamic_resolution ? (*m_wait_stages | VK_PIPELINE_STAGE_TRANSFER_BIT) : *m_wait_stages);
+	submission.signal_semaphores.push_back(m_frames[m_current_frame].render_finished);
+	// The frame serial tells the device when resources used by this frame can be destroyed
+	m_frames[m_current_frame].serial = m_device->SubmitFrame(submission);
+	m_image_frames[currentBuffer] = m_frames[m_current_frame].serial;
+	if (m_dynamic_resolution)
+	{
+		m_timestamps_pending[currentBuffer] = true;
+	}
 }
 
 void Renderer::Vulkan::VulkanSwapchain::Present(std::vector<VkSemaphore> signal_semaphores)
@@ -120,11 +222,15 @@ void Renderer::Vulkan::VulkanSwapchain::Present(std::vector<VkSemaphore> signal_
 	present_info.pImageIndices = &m_active_swapchain_image;
 	present_info.pResults = nullptr;
 
-	vkQueuePresentKHR(
+	present_result = vkQueuePresentKHR(
 		*m_device->GetPresentQueue(),
 		&present_info
 	);
-	vkDeviceWaitIdle(*m_device->GetVulkanDevice());
+	if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR)
+	{
+		RequestRebuildSwapchain();
+	}
+	m_current_frame = (m_current_frame + 1) % m_frames.size();
 }
 
 VkRenderPass * Renderer::Vulkan::VulkanSwapchain::GetRenderPass()
@@ -164,13 +270,31 @@ void Renderer::Vulkan::VulkanSwapchain::AttachGraphicsPipeline(VulkanGraphicsPip
 	}
 }
 
+void Renderer::Vulkan::VulkanSwapchain::AttachDynamicState(VkCommandBuffer & command_buffer)
+{
+	vkCmdSetLineWidth(command_buffer, 1.0f);
+	float width = (float)m_window_handle->width;
+	float height = (float)m_window_handle->height;
+	if (m_dynamic_resolution)
+	{
+		// Only the scaled corner of the offscreen target is drawn to
+		width = (float)m_render_extent.width;
+		height = (float)m_render_extent.height;
+	}
+	const VkViewport viewport = VulkanInitializers::Viewport(width, height, 0.0f, 0.0f, 0.0f, 1.0f);
+	const VkRect2D scissor = VulkanInitializers::Scissor((int)width, (int)height);
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+}
+
 void Renderer::Vulkan::VulkanSwapchain::RemoveGraphicsPipeline(VulkanGraphicsPipeline * pipeline)
 {
 	auto it = std::find(m_pipelines.begin(), m_pipelines.end(), pipeline);
 	if (it != m_pipelines.end())
 	{
 		m_pipelines.erase(it);
-		RebuildSwapchain();
+		// Only the command buffers reference the pipeline, the swapchain itself does not need rebuilding
+		RequestRebuildCommandBuffers();
 	}
 }
 
@@ -201,12 +325,12 @@ std::vector<VkCommandBuffer> Renderer::Vulkan::VulkanSwapchain::GetCommandBuffer
 
 VkSemaphore Renderer::Vulkan::VulkanSwapchain::GetImageAvailableSemaphore()
 {
-	return m_image_available_semaphore;
+	return m_frames[m_current_frame].image_available;
 }
 
 VkSemaphore Renderer::Vulkan::VulkanSwapchain::GetRenderFinishedSemaphore()
 {
-	return m_render_finished_semaphore;
+	return m_frames[m_current_frame].render_finished;
 }
 
 VkFormat Renderer::Vulkan::VulkanSwapchain::GetSwapChainImageFormat()
@@ -224,7 +348,18 @@ VkExtent2D Renderer::Vulkan::VulkanSwapchain::GetSwapchainExtent()
 	return m_swap_chain_extent;
 }
 
+float Renderer::Vulkan::VulkanSwapchain::GetResolutionScale()
+{
+	return m_dynamic_resolution ? m_applied_resolution_scale : 1.0f;
+}
+
 void Renderer::Vulkan::VulkanSwapchain::RebuildCommandBuffers()
+{
+	m_image_frames.resize(m_command_buffers.size(), 0);
+	m_dirty_command_buffers.assign(m_command_buffers.size(), true);
+}
+
+void Renderer::Vulkan::VulkanSwapchain::RecordCommandBuffer(uint32_t index)
 {
 	VkCommandBufferBeginInfo begin_info = VulkanInitializers::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
 	std::array<VkClearValue, 2> clear_values;
@@ -234,53 +369,138 @@ void Renderer::Vulkan::VulkanSwapchain::RebuildCommandBuffers()
 
 	VkRenderPassBeginInfo render_pass_info = VulkanInitializers::RenderPassBeginInfo(m_render_pass, m_swap_chain_extent, clear_values);
 
-	for (uint32_t i = 0; i < m_command_buffers.size(); i++)
+	// Reset the command buffer
+	vkResetCommandBuffer(
+		m_command_buffers[index],
+		0
+	);
+	// Setup unique frame buffer
+	render_pass_info.framebuffer = m_swap_chain_framebuffers[index];
+	if (m_dynamic_resolution)
 	{
-		// Reset the command buffers
-		vkResetCommandBuffer(
-			m_command_buffers[i],
-			0
-		);
-		// Setup unique frame buffer
-		render_pass_info.framebuffer = m_swap_chain_framebuffers[i];
-
+		render_pass_info = VulkanInitializers::RenderPassBeginInfo(m_offscreen_render_pass, m_render_extent, clear_values);
+		render_pass_info.framebuffer = m_offscreen_framebuffer;
+	}
 
-		ErrorCheck(vkBeginCommandBuffer(
-			m_command_buffers[i],
-			&begin_info
-		));
 
-		assert(!HasError() && "Unable to create command buffer");
+	ErrorCheck(vkBeginCommandBuffer(
+		m_command_buffers[index],
+		&begin_info
+	));
 
-		vkCmdBeginRenderPass(
-			m_command_buffers[i],
-			&render_pass_info,
-			VK_SUBPASS_CONTENTS_INLINE
-		);
+	assert(!HasError() && "Unable to create command buffer");
 
+	if (m_dynamic_resolution)
+	{
+		vkCmdResetQueryPool(m_command_buffers[index], m_timestamp_pool, index * 2, 2);
+		vkCmdWriteTimestamp(m_command_buffers[index], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestamp_pool, index * 2);
+	}
 
-		vkCmdSetLineWidth(m_command_buffers[i], 1.0f);
-		const VkViewport viewport = VulkanInitializers::Viewport((float)m_window_handle->width, (float)m_window_handle->height, 0.0f, 0.0f, 0.0f, 1.0f);
-		const VkRect2D scissor = VulkanInitializers::Scissor(m_window_handle->width, m_window_handle->height);
-		vkCmdSetViewport(m_command_buffers[i], 0, 1, &viewport);
-		vkCmdSetScissor(m_command_buffers[i], 0, 1, &scissor);
+	vkCmdBeginRenderPass(
+		m_command_buffers[index],
+		&render_pass_info,
+		VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+	);
 
-		for (auto pipeline : m_pipelines)
+	// Each pipeline keeps its draws in its own secondary buffer, only pipelines that changed record theirs again
+	// Those are independent of each other, so they are recorded across the worker threads
+	VkFramebuffer framebuffer = render_pass_info.framebuffer;
+	std::vector<std::function<void()>> recording_jobs;
+	for (auto pipeline : m_pipelines)
+	{
+		if (pipeline->PrepareCommandBuffer(index))
 		{
-			pipeline->AttachToCommandBuffer(m_command_buffers[i]);
+			recording_jobs.push_back([pipeline, index, framebuffer]()
+			{
+				pipeline->RecordCommandBuffer(index, framebuffer);
+			});
 		}
+	}
+	m_recording_threads->Run(recording_jobs);
 
-		vkCmdEndRenderPass(
-			m_command_buffers[i]
+	std::vector<VkCommandBuffer> secondary_command_buffers;
+	for (auto pipeline : m_pipelines)
+	{
+		secondary_command_buffers.push_back(pipeline->GetCommandBuffer(index, framebuffer));
+	}
+	if (!secondary_command_buffers.empty())
+	{
+		vkCmdExecuteCommands(
+			m_command_buffers[index],
+			(uint32_t)secondary_command_buffers.size(),
+			secondary_command_buffers.data()
 		);
+	}
 
-		ErrorCheck(vkEndCommandBuffer(
-			m_command_buffers[i]
-		));
+	vkCmdEndRenderPass(
+		m_command_buffers[index]
+	);
+
+	if (m_dynamic_resolution)
+	{
+		RecordOffscreenBlit(m_command_buffers[index], index);
+		vkCmdWriteTimestamp(m_command_buffers[index], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestamp_pool, index * 2 + 1);
+	}
 
-		assert(!HasError() && "Unable to end command buffer");
+	ErrorCheck(vkEndCommandBuffer(
+		m_command_buffers[index]
+	));
 
+	assert(!HasError() && "Unable to end command buffer");
+}
+
+bool Renderer::Vulkan::VulkanSwapchain::RecordLateLatches()
+{
+	const std::vector<VulkanUniformBuffer*>& latches = m_device->GetLateLatches();
+	if (latches.empty()) return false;
+	// GetCurrentBuffer waited for the last frame that used this slot, so its command buffer and latch regions are free
+	FrameSync& frame = m_frames[m_current_frame];
+	if (frame.latch_commands == VK_NULL_HANDLE)
+	{
+		m_device->GetGraphicsCommand(&frame.latch_commands);
 	}
+	vkResetCommandBuffer(
+		frame.latch_commands,
+		0
+	);
+	VkCommandBufferBeginInfo begin_info = VulkanInitializers::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	ErrorCheck(vkBeginCommandBuffer(
+		frame.latch_commands,
+		&begin_info
+	));
+	assert(!HasError() && "Unable to begin late latch command buffer");
+
+	// Earlier frames on this queue may still be reading the uniforms
+	VkMemoryBarrier read_barrier = VulkanInitializers::MemoryBarrier(VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+	vkCmdPipelineBarrier(
+		frame.latch_commands,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		1, &read_barrier,
+		0, nullptr,
+		0, nullptr
+	);
+	for (auto latch : latches)
+	{
+		latch->LateLatch(frame.latch_commands, m_current_frame);
+	}
+	VkMemoryBarrier write_barrier = VulkanInitializers::MemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+	vkCmdPipelineBarrier(
+		frame.latch_commands,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		1, &write_barrier,
+		0, nullptr,
+		0, nullptr
+	);
+
+	ErrorCheck(vkEndCommandBuffer(
+		frame.latch_commands
+	));
+	assert(!HasError() && "Unable to end late latch command buffer");
+	return true;
 }
 
 void Renderer::Vulkan::VulkanSwapchain::CreateSwapchain()
@@ -290,10 +510,12 @@ void Renderer::Vulkan::VulkanSwapchain::CreateSwapchain()
 	InitRenderPass();
 	InitDepthImage();
 	InitFrameBuffer();
+	InitOffscreenTarget();
 }
 
 void Renderer::Vulkan::VulkanSwapchain::DestroySwapchain()
 {
+	DeInitOffscreenTarget();
 	DeInitFrameBuffer();
 	DeInitDepthImage();
 	DeInitRenderPass();
@@ -301,6 +523,33 @@ void Renderer::Vulkan::VulkanSwapchain::DestroySwapchain()
 	DeInitSwapchain();
 }
 
+void Renderer::Vulkan::VulkanSwapchain::RetireSwapchain(VkSwapchainKHR old_swap_chain)
+{
+	VulkanDevice* device = m_device;
+	std::vector<VkImageView> image_views = m_swap_chain_image_views;
+	std::vector<VkFramebuffer> framebuffers = m_swap_chain_framebuffers;
+	VkImage depth_image = m_depth_image;
+	VkImageView depth_image_view = m_depth_image_view;
+	VulkanAllocation depth_image_memory = m_depth_image_memory;
+	m_device->DeferDestroy([device, old_swap_chain, image_views, framebuffers, depth_image, depth_image_view, depth_image_memory]() mutable
+	{
+		for (auto framebuffer : framebuffers)
+		{
+			vkDestroyFramebuffer(*device->GetVulkanDevice(), framebuffer, device->GetAllocationCallbacks());
+		}
+		vkDestroyImageView(*device->GetVulkanDevice(), depth_image_view, device->GetAllocationCallbacks());
+		vkDestroyImage(*device->GetVulkanDevice(), depth_image, device->GetAllocationCallbacks());
+		device->GetMemoryAllocator()->Free(depth_image_memory);
+		for (auto image_view : image_views)
+		{
+			vkDestroyImageView(*device->GetVulkanDevice(), image_view, device->GetAllocationCallbacks());
+		}
+		vkDestroySwapchainKHR(*device->GetVulkanDevice(), old_swap_chain, device->GetAllocationCallbacks());
+	});
+	m_swap_chain_image_views.clear();
+	m_swap_chain_framebuffers.clear();
+}
+
 void Renderer::Vulkan::VulkanSwapchain::InitSwapchain()
 {
 	// Get all required information for the swapchain initialization
@@ -315,19 +564,22 @@ void Renderer::Vulkan::VulkanSwapchain::InitSwapchain()
 	m_swap_chain_extent = extent;
 	m_swap_chain_image_format = surface_format.format;
 
-	// Make sure that the amount of images we are creating for the swapchain are in between the min and max
-	image_count = swap_chain_support.capabilities.minImageCount + 1;
-	if (swap_chain_support.capabilities.maxImageCount > 0 && image_count > swap_chain_support.capabilities.maxImageCount)
-	{
-		image_count = swap_chain_support.capabilities.maxImageCount;
-	}
+	image_count = ChooseSwapImageCount(swap_chain_support.capabilities);
 
 	VulkanQueueFamilyIndices indices = *m_device->GetVulkanPhysicalDevice()->GetQueueFamilies();
 	VkSwapchainCreateInfoKHR create_info = VulkanInitializers::SwapchainCreateInfoKHR(surface_format, extent, present_mode, image_count, *m_surface, indices, swap_chain_support);
+	// Null on first creation, when rebuilding the old swapchain is retired by this call but stays valid until it is destroyed
+	create_info.oldSwapchain = m_swap_chain;
+	m_dynamic_resolution = m_configuration.dynamic_resolution && SupportsDynamicResolution(swap_chain_support);
+	if (m_dynamic_resolution)
+	{
+		// The offscreen target is blitted into the images
+		create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
 	ErrorCheck(vkCreateSwapchainKHR(
 		*m_device->GetVulkanDevice(),
 		&create_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_swap_chain
 	));
 
@@ -358,7 +610,7 @@ void Renderer::Vulkan::VulkanSwapchain::DeInitSwapchain()
 	vkDestroySwapchainKHR(
 		*m_device->GetVulkanDevice(),
 		m_swap_chain,
-		nullptr
+		m_device->GetAllocationCallbacks()
 	);
 }
 
@@ -418,14 +670,30 @@ VkSurfaceFormatKHR Renderer::Vulkan::VulkanSwapchain::ChooseSwapSurfaceFormat(co
 
 VkPresentModeKHR Renderer::Vulkan::VulkanSwapchain::ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> available_present_modes)
 {
-	// Loop through modes
-	for (const auto& available_present_mode : available_present_modes)
+	// Modes to try in order, an uncapped request falls back to mailbox before settling on V-Sync
+	std::vector<VkPresentModeKHR> preferred_modes;
+	switch (m_configuration.present_mode)
+	{
+	case PRESENT_MODE_IMMEDIATE:
+		preferred_modes = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR };
+		break;
+	case PRESENT_MODE_MAILBOX:
+		preferred_modes = { VK_PRESENT_MODE_MAILBOX_KHR };
+		break;
+	case PRESENT_MODE_FIFO_RELAXED:
+		preferred_modes = { VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+		break;
+	case PRESENT_MODE_FIFO:
+		break;
+	}
+	for (const auto& preferred_mode : preferred_modes)
 	{
-		// Loop for tipple buffering
-		if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR)
+		for (const auto& available_present_mode : available_present_modes)
 		{
-			// Temporerply dissable everything but V-SYNC
-			return available_present_mode;
+			if (available_present_mode == preferred_mode)
+			{
+				return available_present_mode;
+			}
 		}
 	}
 	// Fallback format that is guaranteed to be available
@@ -433,6 +701,42 @@ VkPresentModeKHR Renderer::Vulkan::VulkanSwapchain::ChooseSwapPresentMode(const
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
+uint32_t Renderer::Vulkan::VulkanSwapchain::ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR & capabilities)
+{
+	uint32_t count = m_configuration.image_count;
+	if (count == 0)
+	{
+		count = capabilities.minImageCount + 1;
+	}
+	// Make sure that the amount of images we are creating for the swapchain are in between the min and max
+	if (count < capabilities.minImageCount)
+	{
+		count = capabilities.minImageCount;
+	}
+	if (capabilities.maxImageCount > 0 && count > capabilities.maxImageCount)
+	{
+		count = capabilities.maxImageCount;
+	}
+	return count;
+}
+
+bool Renderer::Vulkan::VulkanSwapchain::SupportsDynamicResolution(const VulkanSwapChainSupport & support)
+{
+	if (!m_device->GetVulkanPhysicalDevice()->GetPhysicalDeviceProperties()->limits.timestampComputeAndGraphics) return false;
+	if (!(support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)) return false;
+	// The offscreen target shares the swapchain format, so one format has to allow blitting both ways
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(
+		*m_device->GetVulkanPhysicalDevice()->GetPhysicalDevice(),
+		m_swap_chain_image_format,
+		&format_properties
+	);
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+	if ((format_properties.optimalTilingFeatures & required) != required) return false;
+	m_blit_filter = (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+	return true;
+}
+
 VkExtent2D Renderer::Vulkan::VulkanSwapchain::ChooseSwapExtent(const VkSurfaceCapabilitiesKHR & capabilities)
 {
 	if (capabilities.currentExtent.width != UINT32_MAX)
@@ -470,7 +774,7 @@ void Renderer::Vulkan::VulkanSwapchain::DeInitSwapchainImages()
 		vkDestroyImageView(
 			*m_device->GetVulkanDevice(),
 			m_swap_chain_image_views[i],
-			nullptr
+			m_device->GetAllocationCallbacks()
 		);
 	}
 	m_swap_chain_image_views.clear();
@@ -495,7 +799,7 @@ void Renderer::Vulkan::VulkanSwapchain::InitRenderPass()
 	ErrorCheck(vkCreateRenderPass(
 		*m_device->GetVulkanDevice(),
 		&render_pass_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_render_pass
 	));
 	assert(!HasError() && "Unable to initialize render pass");
@@ -506,7 +810,7 @@ void Renderer::Vulkan::VulkanSwapchain::DeInitRenderPass()
 	vkDestroyRenderPass(
 		*m_device->GetVulkanDevice(),
 		m_render_pass,
-		nullptr);
+		m_device->GetAllocationCallbacks());
 }
 
 void Renderer::Vulkan::VulkanSwapchain::InitCommandBuffers()
@@ -541,18 +845,14 @@ void Renderer::Vulkan::VulkanSwapchain::DeInitDepthImage()
 	vkDestroyImageView(
 		*m_device->GetVulkanDevice(),
 		m_depth_image_view,
-		nullptr
-	);
-	vkFreeMemory(
-		*m_device->GetVulkanDevice(),
-		m_depth_image_memory,
-		nullptr
+		m_device->GetAllocationCallbacks()
 	);
 	vkDestroyImage(
 		*m_device->GetVulkanDevice(),
 		m_depth_image,
-		nullptr
+		m_device->GetAllocationCallbacks()
 	);
+	m_device->GetMemoryAllocator()->Free(m_depth_image_memory);
 }
 
 void Renderer::Vulkan::VulkanSwapchain::InitFrameBuffer()
@@ -570,7 +870,7 @@ void Renderer::Vulkan::VulkanSwapchain::InitFrameBuffer()
 		ErrorCheck(vkCreateFramebuffer(
 			*m_device->GetVulkanDevice(),
 			&framebuffer_info,
-			nullptr,
+			m_device->GetAllocationCallbacks(),
 			&m_swap_chain_framebuffers[i]
 		));
 		assert(!HasError() && "Unable to create frame buffer");
@@ -584,24 +884,225 @@ void Renderer::Vulkan::VulkanSwapchain::DeInitFrameBuffer()
 		vkDestroyFramebuffer(
 			*m_device->GetVulkanDevice(),
 			framebuffer,
-			nullptr
+			m_device->GetAllocationCallbacks()
 		);
 	}
 }
 
+void Renderer::Vulkan::VulkanSwapchain::InitOffscreenTarget()
+{
+	UpdateRenderExtent();
+	if (!m_dynamic_resolution) return;
+
+	// Same attachments as the main render pass so pipelines work with either, the color is left ready to blit from
+	std::vector<VkAttachmentDescription> attachments = {
+		VulkanInitializers::AttachmentDescription(m_swap_chain_image_format, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),	//Color
+		VulkanInitializers::AttachmentDescription(VulkanCommon::GetDepthImageFormat(m_device), VK_ATTACHMENT_STORE_OP_DONT_CARE, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)		// Depth
+	};
+	VkAttachmentReference color_attachment_refrence = VulkanInitializers::AttachmentReference(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, 0);
+	VkAttachmentReference depth_attachment_refrence = VulkanInitializers::AttachmentReference(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+	VkSubpassDescription subpass = VulkanInitializers::SubpassDescription(color_attachment_refrence, depth_attachment_refrence);
+	VkSubpassDependency subpass_dependency = VulkanInitializers::SubpassDependency();
+	VkRenderPassCreateInfo render_pass_info = VulkanInitializers::RenderPassCreateInfo(attachments, subpass, subpass_dependency);
+	ErrorCheck(vkCreateRenderPass(
+		*m_device->GetVulkanDevice(),
+		&render_pass_info,
+		m_device->GetAllocationCallbacks(),
+		&m_offscreen_render_pass
+	));
+	assert(!HasError() && "Unable to initialize offscreen render pass");
+
+	VulkanCommon::CreateImage(m_device, m_swap_chain_extent, m_swap_chain_image_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_offscreen_image, m_offscreen_image_memory);
+	VulkanCommon::CreateImageView(m_device, m_offscreen_image, m_swap_chain_image_format, VK_IMAGE_ASPECT_COLOR_BIT, m_offscreen_image_view);
+
+	// The depth image is only used by one of the two framebuffers at a time, so they share it
+	std::vector<VkImageView> framebuffer_attachments = {
+		m_offscreen_image_view,
+		m_depth_image_view
+	};
+	VkFramebufferCreateInfo framebuffer_info = VulkanInitializers::FramebufferCreateInfo(m_swap_chain_extent, framebuffer_attachments, m_offscreen_render_pass);
+	ErrorCheck(vkCreateFramebuffer(
+		*m_device->GetVulkanDevice(),
+		&framebuffer_info,
+		m_device->GetAllocationCallbacks(),
+		&m_offscreen_framebuffer
+	));
+	assert(!HasError() && "Unable to create offscreen frame buffer");
+
+	VkQueryPoolCreateInfo query_pool_info = {};
+	query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	query_pool_info.queryCount = (uint32_t)m_swap_chain_images.size() * 2;
+	ErrorCheck(vkCreateQueryPool(
+		*m_device->GetVulkanDevice(),
+		&query_pool_info,
+		m_device->GetAllocationCallbacks(),
+		&m_timestamp_pool
+	));
+	assert(!HasError() && "Unable to create timestamp query pool");
+	m_timestamps_pending.assign(m_swap_chain_images.size(), false);
+}
+
+void Renderer::Vulkan::VulkanSwapchain::DeInitOffscreenTarget()
+{
+	if (m_offscreen_render_pass == VK_NULL_HANDLE) return;
+	// Frames in flight may still be drawing to the target or writing their timestamps
+	VulkanDevice* device = m_device;
+	VkRenderPass render_pass = m_offscreen_render_pass;
+	VkImage image = m_offscreen_image;
+	VulkanAllocation image_memory = m_offscreen_image_memory;
+	VkImageView image_view = m_offscreen_image_view;
+	VkFramebuffer framebuffer = m_offscreen_framebuffer;
+	VkQueryPool timestamp_pool = m_timestamp_pool;
+	m_device->DeferDestroy([device, render_pass, image, image_memory, image_view, framebuffer, timestamp_pool]() mutable
+	{
+		vkDestroyQueryPool(*device->GetVulkanDevice(), timestamp_pool, device->GetAllocationCallbacks());
+		vkDestroyFramebuffer(*device->GetVulkanDevice(), framebuffer, device->GetAllocationCallbacks());
+		vkDestroyImageView(*device->GetVulkanDevice(), image_view, device->GetAllocationCallbacks());
+		vkDestroyImage(*device->GetVulkanDevice(), image, device->GetAllocationCallbacks());
+		device->GetMemoryAllocator()->Free(image_memory);
+		vkDestroyRenderPass(*device->GetVulkanDevice(), render_pass, device->GetAllocationCallbacks());
+	});
+	m_offscreen_render_pass = VK_NULL_HANDLE;
+	m_offscreen_image = VK_NULL_HANDLE;
+	m_offscreen_image_view = VK_NULL_HANDLE;
+	m_offscreen_framebuffer = VK_NULL_HANDLE;
+	m_timestamp_pool = VK_NULL_HANDLE;
+	m_timestamps_pending.clear();
+}
+
+void Renderer::Vulkan::VulkanSwapchain::RecordOffscreenBlit(VkCommandBuffer command_buffer, uint32_t index)
+{
+	VkImageMemoryBarrier to_transfer = VulkanInitializers::ImageMemoryBarrier();
+	to_transfer.srcAccessMask = 0;
+	to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	to_transfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	to_transfer.image = m_swap_chain_images[index];
+	to_transfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	// Chained to the image available semaphore, which is waited on at the transfer stage
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &to_transfer
+	);
+
+	VkImageBlit blit = {};
+	blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.srcOffsets[1] = { (int32_t)m_render_extent.width, (int32_t)m_render_extent.height, 1 };
+	blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.dstOffsets[1] = { (int32_t)m_swap_chain_extent.width, (int32_t)m_swap_chain_extent.height, 1 };
+	vkCmdBlitImage(
+		command_buffer,
+		m_offscreen_image,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		m_swap_chain_images[index],
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1,
+		&blit,
+		m_blit_filter
+	);
+
+	// The next frame renders into the same target, so its color writes wait for this blit to finish reading
+	std::array<VkImageMemoryBarrier, 2> barriers = { VulkanInitializers::ImageMemoryBarrier(), VulkanInitializers::ImageMemoryBarrier() };
+	barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[0].dstAccessMask = 0;
+	barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	barriers[0].image = m_swap_chain_images[index];
+	barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	barriers[1].image = m_offscreen_image;
+	barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		(uint32_t)barriers.size(), barriers.data()
+	);
+}
+
+void Renderer::Vulkan::VulkanSwapchain::UpdateResolutionScale(uint32_t index)
+{
+	if (!m_dynamic_resolution || !m_timestamps_pending[index]) return;
+	m_timestamps_pending[index] = false;
+	// The image's last frame has finished, so its timestamps are ready
+	uint64_t timestamps[2];
+	VkResult result = vkGetQueryPoolResults(
+		*m_device->GetVulkanDevice(),
+		m_timestamp_pool,
+		index * 2,
+		2,
+		sizeof(timestamps),
+		timestamps,
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT
+	);
+	if (result != VK_SUCCESS || timestamps[1] < timestamps[0]) return;
+	float timestamp_period = m_device->GetVulkanPhysicalDevice()->GetPhysicalDeviceProperties()->limits.timestampPeriod;
+	float frame_time = (float)(timestamps[1] - timestamps[0]) * timestamp_period / 1000000.0f;
+	// Smoothed so a single slow frame does not change the resolution
+	m_gpu_frame_time = m_gpu_frame_time == 0.0f ? frame_time : m_gpu_frame_time * 0.9f + frame_time * 0.1f;
+
+	// GPU time roughly follows the pixel count, which grows with the square of the scale
+	float ideal_scale = m_resolution_scale * sqrtf(m_configuration.target_frame_time / std::max(m_gpu_frame_time, 0.001f));
+	m_resolution_scale += (ideal_scale - m_resolution_scale) * 0.25f;
+	m_resolution_scale = std::min(std::max(m_resolution_scale, m_configuration.min_resolution_scale), m_configuration.max_resolution_scale);
+
+	float applied_scale = roundf(m_resolution_scale / m_resolution_scale_step) * m_resolution_scale_step;
+	applied_scale = std::min(std::max(applied_scale, m_configuration.min_resolution_scale), m_configuration.max_resolution_scale);
+	if (fabsf(applied_scale - m_applied_resolution_scale) < m_resolution_scale_step * 0.5f) return;
+	m_applied_resolution_scale = applied_scale;
+	UpdateRenderExtent();
+	// The viewport is part of every cached command buffer
+	for (auto pipeline : m_pipelines)
+	{
+		pipeline->InvalidateCommandBuffers();
+	}
+	RebuildCommandBuffers();
+}
+
+void Renderer::Vulkan::VulkanSwapchain::UpdateRenderExtent()
+{
+	m_render_extent = m_swap_chain_extent;
+	if (!m_dynamic_resolution) return;
+	m_render_extent.width = std::max((uint32_t)(m_swap_chain_extent.width * m_applied_resolution_scale), 1u);
+	m_render_extent.height = std::max((uint32_t)(m_swap_chain_extent.height * m_applied_resolution_scale), 1u);
+}
+
 void Renderer::Vulkan::VulkanSwapchain::InitSemaphores()
 {
 	VkSemaphoreCreateInfo semaphore_info = VulkanInitializers::SemaphoreCreateInfo();
 
-	ErrorCheck(vkCreateSemaphore(*m_device->GetVulkanDevice(), &semaphore_info, nullptr, &m_image_available_semaphore));
-	assert(!HasError() && "Unable to create semaphore");
+	for (auto& frame : m_frames)
+	{
+		ErrorCheck(vkCreateSemaphore(*m_device->GetVulkanDevice(), &semaphore_info, m_device->GetAllocationCallbacks(), &frame.image_available));
+		assert(!HasError() && "Unable to create semaphore");
 
-	ErrorCheck(vkCreateSemaphore(*m_device->GetVulkanDevice(), &semaphore_info, nullptr, &m_render_finished_semaphore));
-	assert(!HasError() && "Unable to create semaphore");
+		ErrorCheck(vkCreateSemaphore(*m_device->GetVulkanDevice(), &semaphore_info, m_device->GetAllocationCallbacks(), &frame.render_finished));
+		assert(!HasError() && "Unable to create semaphore");
+	}
 }
 
 void Renderer::Vulkan::VulkanSwapchain::DeInitSemaphores()
 {
-	vkDestroySemaphore(*m_device->GetVulkanDevice(), m_image_available_semaphore, nullptr);
-	vkDestroySemaphore(*m_device->GetVulkanDevice(), m_render_finished_semaphore, nullptr);
+	for (auto& frame : m_frames)
+	{
+		vkDestroySemaphore(*m_device->GetVulkanDevice(), frame.image_available, m_device->GetAllocationCallbacks());
+		vkDestroySemaphore(*m_device->GetVulkanDevice(), frame.render_finished, m_device->GetAllocationCallbacks());
+		if (frame.latch_commands != VK_NULL_HANDLE)
+		{
+			m_device->FreeGraphicsCommand(&frame.latch_commands, 1);
+		}
+	}
 }
@@ -1,6 +1,8 @@
 #include <renderer/vulkan/VulkanTextureBuffer.hpp>
 #include <renderer/vulkan/VulkanCommon.hpp>
 #include <renderer/vulkan/VulkanPhysicalDevice.hpp>
+#include <renderer/vulkan/VulkanDevice.hpp>
+#include <renderer/vulkan/VulkanUploadBatch.hpp>
 
 using namespace Renderer;
 using namespace Renderer::Vulkan;
@@ -21,26 +23,31 @@ Renderer::Vulkan::VulkanTextureBuffer::VulkanTextureBuffer(VulkanDevice* device,
 
 Renderer::Vulkan::VulkanTextureBuffer::~VulkanTextureBuffer()
 {
-	vkDestroyImage(
-		*m_device->GetVulkanDevice(),
-		m_image,
-		nullptr
-	);
-	vkDestroySampler(
-		*m_device->GetVulkanDevice(),
-		m_sampler,
-		nullptr
-	);
-	vkDestroyImageView(
-		*m_device->GetVulkanDevice(),
-		m_view,
-		nullptr
-	);
-	vkFreeMemory(
-		*m_device->GetVulkanDevice(),
-		m_device_memory,
-		nullptr
-	);
+	// The image may still have a copy waiting in the upload batch or be sampled by a frame in flight
+	VulkanDevice* device = m_device;
+	VkImage image = m_image;
+	VkSampler sampler = m_sampler;
+	VkImageView view = m_view;
+	VulkanAllocation memory = m_device_memory;
+	m_device->DeferDestroy([device, image, sampler, view, memory]() mutable
+	{
+		vkDestroyImage(
+			*device->GetVulkanDevice(),
+			image,
+			device->GetAllocationCallbacks()
+		);
+		vkDestroySampler(
+			*device->GetVulkanDevice(),
+			sampler,
+			device->GetAllocationCallbacks()
+		);
+		vkDestroyImageView(
+			*device->GetVulkanDevice(),
+			view,
+			device->GetAllocationCallbacks()
+		);
+		device->GetMemoryAllocator()->Free(memory);
+	});
 }
 
 VkImage & Renderer::Vulkan::VulkanTextureBuffer::GetImage()
@@ -50,7 +57,6 @@ VkImage & Renderer::Vulkan::VulkanTextureBuffer::GetImage()
 
 void Renderer::Vulkan::VulkanTextureBuffer::SetData(BufferSlot slot)
 {
-	VulkanBuffer::SetData(slot);
 	MoveDataToImage();
 }
 
@@ -99,7 +105,7 @@ void Renderer::Vulkan::VulkanTextureBuffer::InitTexture()
 	ErrorCheck(vkCreateImage(
 		*m_device->GetVulkanDevice(),
 		&image_create_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_image
 	));
 
@@ -112,24 +118,32 @@ void Renderer::Vulkan::VulkanTextureBuffer::InitTexture()
 	);
 
 
-	VkMemoryAllocateInfo mem_alloc_info = VulkanInitializers::MemoryAllocateInfo(mem_reqs.size, VulkanCommon::FindMemoryType(
-		m_device->GetVulkanPhysicalDevice(),
-		mem_reqs.memoryTypeBits,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-	));
-
-	ErrorCheck(vkAllocateMemory(
-		*m_device->GetVulkanDevice(),
-		&mem_alloc_info,
-		nullptr,
-		&m_device_memory
-	));
+	bool allocated = m_device->GetMemoryAllocator()->Allocate(
+		mem_reqs,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		0,
+		false,
+		m_device_memory,
+		MEMORY_CATEGORY_TEXTURE
+	);
+	if (!allocated)
+	{
+		// The texture is left empty, with the error recorded
+		ErrorCheck(VK_ERROR_OUT_OF_DEVICE_MEMORY);
+		vkDestroyImage(
+			*m_device->GetVulkanDevice(),
+			m_image,
+			m_device->GetAllocationCallbacks()
+		);
+		m_image = VK_NULL_HANDLE;
+		return;
+	}
 
 	ErrorCheck(vkBindImageMemory(
 		*m_device->GetVulkanDevice(),
 		m_image,
-		m_device_memory,
-		0
+		m_device_memory.memory,
+		m_device_memory.offset
 	));
 
 
@@ -170,7 +184,7 @@ void Renderer::Vulkan::VulkanTextureBuffer::InitTexture()
 	ErrorCheck(vkCreateSampler(
 		*m_device->GetVulkanDevice(),
 		&sampler_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_sampler
 	));
 
@@ -186,7 +200,7 @@ void Renderer::Vulkan::VulkanTextureBuffer::InitTexture()
 	ErrorCheck(vkCreateImageView(
 		*m_device->GetVulkanDevice(),
 		&view_info,
-		nullptr,
+		m_device->GetAllocationCallbacks(),
 		&m_view
 	));
 
@@ -198,9 +212,7 @@ void Renderer::Vulkan::VulkanTextureBuffer::InitTexture()
 
 void Renderer::Vulkan::VulkanTextureBuffer::MoveDataToImage()
 {
-	VkCommandBuffer copy_cmd;
-	m_device->GetGraphicsCommand(&copy_cmd, true);
-
+	if (m_image == VK_NULL_HANDLE) return;
 	// The sub resource range describes the regions of the image we will be transition
 	VkImageSubresourceRange subresourceRange = {};
 	// Image only contains color data
@@ -212,50 +224,20 @@ void Renderer::Vulkan::VulkanTextureBuffer::MoveDataToImage()
 	// The 2D texture only has one layer
 	subresourceRange.layerCount = 1;
 
-	// Optimal image will be used as destination for the copy, so we must transfer from our
-	// initial undefined image layout to the transfer destination layout
-
-	VulkanCommon::SetImageLayout(
-		copy_cmd,
-		m_image,
-		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		subresourceRange//,
-		//VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-		//VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
-	);
-
-
-	// Copy mip levels from staging buffer
-	vkCmdCopyBufferToImage(
-		copy_cmd,
-		GetBufferData(BufferSlot::Primary)->buffer,
-		m_image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		static_cast<uint32_t>(m_bufferCopyRegions.size()),
-		m_bufferCopyRegions.data());
-
-
 	// Change texture image layout to shader read after all mip levels have been copied
 	m_image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-	VulkanCommon::SetImageLayout(
-		copy_cmd,
+	// Copy mip levels through the staging ring, the copy is submitted with the rest of the pending uploads
+	// and runs on the transfer queue when the device has one
+	m_device->GetUploadBatch()->UploadImage(
 		m_image,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		m_local_allocation[BufferSlot::Primary].dataPtr,
+		m_local_allocation[BufferSlot::Primary].bufferSize,
+		m_bufferCopyRegions,
+		subresourceRange,
 		m_image_layout,
-		subresourceRange//,
-		//VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-		//VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
-		);
-
-
-	ErrorCheck(vkEndCommandBuffer(copy_cmd));
-
-
-	m_device->SubmitGraphicsCommand(&copy_cmd, 1);
-
-	m_device->FreeGraphicsCommand(&copy_cmd, 1);
+		&m_graphics_owned
+	);
 }
 
 unsigned int Renderer::Vulkan::VulkanTextureBuffer::GetFormatSize(DataFormat format)
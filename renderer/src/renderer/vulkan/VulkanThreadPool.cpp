@@ -0,0 +1,81 @@
+#include <renderer/vulkan/VulkanThreadPool.hpp>
+
+Renderer::Vulkan::VulkanThreadPool::VulkanThreadPool(unsigned int thread_count)
+{
+	for (unsigned int i = 0; i < thread_count; i++)
+	{
+		m_threads.push_back(std::thread(&VulkanThreadPool::WorkerLoop, this));
+	}
+}
+
+Renderer::Vulkan::VulkanThreadPool::~VulkanThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_work_ready.notify_all();
+	for (auto& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void Renderer::Vulkan::VulkanThreadPool::Run(const std::vector<std::function<void()>>& jobs)
+{
+	if (jobs.empty()) return;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_jobs = &jobs;
+	m_job_count = jobs.size();
+	m_next_job = 0;
+	m_remaining_jobs = jobs.size();
+	// A single job is cheaper to run here than to wake a worker for
+	if (m_job_count > 1)
+	{
+		m_work_ready.notify_all();
+	}
+	RunJobs(lock);
+	m_work_done.wait(lock, [this]() { return m_remaining_jobs == 0; });
+	m_jobs = nullptr;
+	m_job_count = 0;
+	m_next_job = 0;
+}
+
+unsigned int Renderer::Vulkan::VulkanThreadPool::GetThreadCount()
+{
+	return (unsigned int)m_threads.size();
+}
+
+unsigned int Renderer::Vulkan::VulkanThreadPool::GetDefaultThreadCount()
+{
+	// May be 0 when the count can not be detected
+	unsigned int hardware_threads = std::thread::hardware_concurrency();
+	return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+void Renderer::Vulkan::VulkanThreadPool::WorkerLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		m_work_ready.wait(lock, [this]() { return m_stop || m_next_job < m_job_count; });
+		if (m_stop) return;
+		RunJobs(lock);
+	}
+}
+
+void Renderer::Vulkan::VulkanThreadPool::RunJobs(std::unique_lock<std::mutex>& lock)
+{
+	while (m_next_job < m_job_count)
+	{
+		const std::function<void()>& job = (*m_jobs)[m_next_job++];
+		lock.unlock();
+		job();
+		lock.lock();
+		m_remaining_jobs--;
+		if (m_remaining_jobs == 0)
+		{
+			m_work_done.notify_all();
+		}
+	}
+}
@@ -0,0 +1,236 @@
+#include <renderer/vulkan/VulkanTimeline.hpp>
+#include <renderer/vulkan/VulkanDevice.hpp>
+#include <renderer/vulkan/VulkanPhysicalDevice.hpp>
+#include <renderer/vulkan/VulkanInitializers.hpp>
+
+#include <assert.h>
+
+Renderer::Vulkan::VulkanTimeline::VulkanTimeline(VulkanDevice * device, VkQueue queue)
+{
+	m_device = device;
+	m_queue = queue;
+#ifdef VK_KHR_timeline_semaphore
+	if (m_device->GetVulkanPhysicalDevice()->HasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+	{
+		m_get_semaphore_counter_value = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(*m_device->GetVulkanDevice(), "vkGetSemaphoreCounterValueKHR");
+		m_wait_semaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(*m_device->GetVulkanDevice(), "vkWaitSemaphoresKHR");
+		VkSemaphoreTypeCreateInfoKHR type_info = {};
+		type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		type_info.initialValue = 0;
+		VkSemaphoreCreateInfo semaphore_info = VulkanInitializers::SemaphoreCreateInfo();
+		semaphore_info.pNext = &type_info;
+		ErrorCheck(vkCreateSemaphore(
+			*m_device->GetVulkanDevice(),
+			&semaphore_info,
+			m_device->GetAllocationCallbacks(),
+			&m_semaphore
+		));
+		assert(!HasError() && "Unable to create timeline semaphore");
+	}
+#endif
+}
+
+Renderer::Vulkan::VulkanTimeline::~VulkanTimeline()
+{
+	WaitIdle();
+	for (auto fence : m_free_fences)
+	{
+		vkDestroyFence(
+			*m_device->GetVulkanDevice(),
+			fence,
+			m_device->GetAllocationCallbacks()
+		);
+	}
+	if (m_semaphore != VK_NULL_HANDLE)
+	{
+		vkDestroySemaphore(
+			*m_device->GetVulkanDevice(),
+			m_semaphore,
+			m_device->GetAllocationCallbacks()
+		);
+	}
+}
+
+Renderer::Vulkan::VulkanTimelinePoint Renderer::Vulkan::VulkanTimeline::Submit(const VulkanSubmission & submission)
+{
+	std::vector<VkSemaphore> wait_semaphores = submission.wait_semaphores;
+	std::vector<VkPipelineStageFlags> wait_stages = submission.wait_semaphore_stages;
+	std::vector<uint64_t> wait_values(wait_semaphores.size(), 0);
+	for (size_t i = 0; i < submission.wait_points.size(); i++)
+	{
+		const VulkanTimelinePoint& point = submission.wait_points[i];
+		// Work on the same queue is already ordered by the barriers it records
+		if (point.timeline == nullptr || point.timeline->GetQueue() == m_queue) continue;
+		if (point.timeline->IsComplete(point.value)) continue;
+		if (m_semaphore != VK_NULL_HANDLE && point.timeline->m_semaphore != VK_NULL_HANDLE)
+		{
+			wait_semaphores.push_back(point.timeline->m_semaphore);
+			wait_stages.push_back(submission.wait_point_stages[i]);
+			wait_values.push_back(point.value);
+		}
+		else
+		{
+			// Without timeline semaphores the other queue is waited on from the CPU
+			point.timeline->Wait(point.value);
+		}
+	}
+
+	std::vector<VkSemaphore> signal_semaphores = submission.signal_semaphores;
+	std::vector<uint64_t> signal_values(signal_semaphores.size(), 0);
+	uint64_t value = ++m_submitted_value;
+
+	VkSubmitInfo submit_info = VulkanInitializers::SubmitInfo(const_cast<VkCommandBuffer*>(submission.command_buffers.data()), (uint32_t)submission.command_buffers.size());
+	VkFence fence = VK_NULL_HANDLE;
+#ifdef VK_KHR_timeline_semaphore
+	VkTimelineSemaphoreSubmitInfoKHR timeline_info = {};
+	if (m_semaphore != VK_NULL_HANDLE)
+	{
+		signal_semaphores.push_back(m_semaphore);
+		signal_values.push_back(value);
+		// Binary semaphores are given a value too, it is ignored
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+		timeline_info.waitSemaphoreValueCount = (uint32_t)wait_values.size();
+		timeline_info.pWaitSemaphoreValues = wait_values.data();
+		timeline_info.signalSemaphoreValueCount = (uint32_t)signal_values.size();
+		timeline_info.pSignalSemaphoreValues = signal_values.data();
+		submit_info.pNext = &timeline_info;
+	}
+#endif
+	if (m_semaphore == VK_NULL_HANDLE)
+	{
+		fence = GetFence();
+		m_pending_fences.push_back({ value, fence });
+	}
+	submit_info.waitSemaphoreCount = (uint32_t)wait_semaphores.size();
+	submit_info.pWaitSemaphores = wait_semaphores.data();
+	submit_info.pWaitDstStageMask = wait_stages.data();
+	submit_info.signalSemaphoreCount = (uint32_t)signal_semaphores.size();
+	submit_info.pSignalSemaphores = signal_semaphores.data();
+	ErrorCheck(vkQueueSubmit(
+		m_queue,
+		1,
+		&submit_info,
+		fence
+	));
+	assert(!HasError() && "Unable to submit to queue");
+
+	VulkanTimelinePoint point;
+	point.timeline = this;
+	point.value = value;
+	return point;
+}
+
+bool Renderer::Vulkan::VulkanTimeline::IsComplete(uint64_t value)
+{
+	if (value <= m_completed_value) return true;
+#ifdef VK_KHR_timeline_semaphore
+	if (m_semaphore != VK_NULL_HANDLE)
+	{
+		uint64_t counter = 0;
+		ErrorCheck(m_get_semaphore_counter_value(*m_device->GetVulkanDevice(), m_semaphore, &counter));
+		if (counter > m_completed_value) m_completed_value = counter;
+		return value <= m_completed_value;
+	}
+#endif
+	RetireFences(false, value);
+	return value <= m_completed_value;
+}
+
+void Renderer::Vulkan::VulkanTimeline::Wait(uint64_t value)
+{
+	if (value <= m_completed_value) return;
+	assert(value <= m_submitted_value && "Waiting on a value that has not been submitted");
+#ifdef VK_KHR_timeline_semaphore
+	if (m_semaphore != VK_NULL_HANDLE)
+	{
+		VkSemaphoreWaitInfoKHR wait_info = {};
+		wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+		wait_info.semaphoreCount = 1;
+		wait_info.pSemaphores = &m_semaphore;
+		wait_info.pValues = &value;
+		ErrorCheck(m_wait_semaphores(*m_device->GetVulkanDevice(), &wait_info, UINT64_MAX));
+		assert(!HasError() && "Unable to wait for timeline semaphore");
+		m_completed_value = value;
+		return;
+	}
+#endif
+	RetireFences(true, value);
+}
+
+void Renderer::Vulkan::VulkanTimeline::WaitIdle()
+{
+	Wait(m_submitted_value);
+}
+
+uint64_t Renderer::Vulkan::VulkanTimeline::GetSubmittedValue()
+{
+	return m_submitted_value;
+}
+
+uint64_t Renderer::Vulkan::VulkanTimeline::GetCompletedValue()
+{
+	IsComplete(m_submitted_value);
+	return m_completed_value;
+}
+
+VkQueue Renderer::Vulkan::VulkanTimeline::GetQueue()
+{
+	return m_queue;
+}
+
+bool Renderer::Vulkan::VulkanTimeline::UsesTimelineSemaphore()
+{
+	return m_semaphore != VK_NULL_HANDLE;
+}
+
+void Renderer::Vulkan::VulkanTimeline::RetireFences(bool wait, uint64_t value)
+{
+	while (!m_pending_fences.empty())
+	{
+		PendingFence& pending = m_pending_fences.front();
+		if (wait && pending.value <= value)
+		{
+			ErrorCheck(vkWaitForFences(
+				*m_device->GetVulkanDevice(),
+				1,
+				&pending.fence,
+				VK_TRUE,
+				UINT64_MAX
+			));
+			assert(!HasError() && "Unable to wait for queue fence");
+		}
+		else if (vkGetFenceStatus(*m_device->GetVulkanDevice(), pending.fence) != VK_SUCCESS)
+		{
+			break;
+		}
+		vkResetFences(
+			*m_device->GetVulkanDevice(),
+			1,
+			&pending.fence
+		);
+		m_free_fences.push_back(pending.fence);
+		m_completed_value = pending.value;
+		m_pending_fences.pop_front();
+	}
+}
+
+VkFence Renderer::Vulkan::VulkanTimeline::GetFence()
+{
+	if (!m_free_fences.empty())
+	{
+		VkFence fence = m_free_fences.back();
+		m_free_fences.pop_back();
+		return fence;
+	}
+	VkFence fence = VK_NULL_HANDLE;
+	VkFenceCreateInfo fence_info = VulkanInitializers::CreateFenceInfo();
+	ErrorCheck(vkCreateFence(
+		*m_device->GetVulkanDevice(),
+		&fence_info,
+		m_device->GetAllocationCallbacks(),
+		&fence
+	));
+	assert(!HasError() && "Unable to create queue fence");
+	return fence;
+}
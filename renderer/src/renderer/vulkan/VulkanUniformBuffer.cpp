@@ -1,15 +1,20 @@
 #include <renderer/vulkan/VulkanUniformBuffer.hpp>
 #include <renderer/vulkan/VulkanBuffer.hpp>
 #include <renderer/vulkan/VulkanInitializers.hpp>
+#include <renderer/vulkan/VulkanCommon.hpp>
 
 #include <renderer/ShaderStage.hpp>
 
+#include <assert.h>
+
 using namespace Renderer::Vulkan;
 
-Renderer::Vulkan::VulkanUniformBuffer::VulkanUniformBuffer(VulkanDevice * device, BufferChain level, void * dataPtr, unsigned int indexSize, unsigned int elementCount, bool modifiable) :
+const unsigned int Renderer::Vulkan::VulkanUniformBuffer::m_latch_frames = 3;
+
+Renderer::Vulkan::VulkanUniformBuffer::VulkanUniformBuffer(VulkanDevice * device, BufferChain level, void * dataPtr, unsigned int indexSize, unsigned int elementCount, bool modifiable, BufferUsageHint usage) :
 	VulkanBuffer(device, level, dataPtr, indexSize, elementCount,
-		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (modifiable ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0) ,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | (modifiable ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : 0) ,
+		RequiredMemoryPropertys(usage), PreferredMemoryPropertys(usage)),
 	IUniformBuffer(level),
 	IBuffer(level)
 {
@@ -22,10 +27,13 @@ Renderer::Vulkan::VulkanUniformBuffer::VulkanUniformBuffer(VulkanDevice * device
 
 Renderer::Vulkan::VulkanUniformBuffer::~VulkanUniformBuffer()
 {
+	ClearLateLatch();
 }
 
 void Renderer::Vulkan::VulkanUniformBuffer::GetData(BufferSlot slot)
 {
+	assert(m_gpu_allocation[slot].mapped && "Reading back a buffer requires host visible memory");
+	Invalidate(slot);
 	memcpy(
 		m_local_allocation[slot].dataPtr, 
 		m_gpu_allocation[slot].buffer.mapped_memory, 
@@ -35,6 +43,8 @@ void Renderer::Vulkan::VulkanUniformBuffer::GetData(BufferSlot slot)
 
 void Renderer::Vulkan::VulkanUniformBuffer::GetData(BufferSlot slot,unsigned int count)
 {
+	assert(m_gpu_allocation[slot].mapped && "Reading back a buffer requires host visible memory");
+	Invalidate(slot);
 	memcpy(
 		m_local_allocation[slot].dataPtr,
 		m_gpu_allocation[slot].buffer.mapped_memory, 
@@ -44,9 +54,86 @@ void Renderer::Vulkan::VulkanUniformBuffer::GetData(BufferSlot slot,unsigned int
 
 void Renderer::Vulkan::VulkanUniformBuffer::GetData(BufferSlot slot,unsigned int startIndex, unsigned int count)
 {
+	assert(m_gpu_allocation[slot].mapped && "Reading back a buffer requires host visible memory");
+	Invalidate(slot);
 	memcpy(
 		((char*)m_local_allocation[slot].dataPtr) + (startIndex * m_local_allocation[slot].indexSize),
 		((char*)m_gpu_allocation[slot].buffer.mapped_memory) + (startIndex * m_local_allocation[slot].indexSize),
 		(::size_t)m_local_allocation[slot].indexSize * count
 	);
 }
+
+void Renderer::Vulkan::VulkanUniformBuffer::SetLateLatch(BufferSlot slot, std::function<void(void*data)> callback)
+{
+	ClearLateLatch();
+	m_latch_slot = slot;
+	m_latch_callback = callback;
+	VulkanCommon::CreateBuffer(
+		m_device,
+		(VkDeviceSize)m_local_allocation[slot].bufferSize * m_latch_frames,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		m_latch_buffer
+	);
+	VulkanCommon::MapBufferMemory(m_device, m_latch_buffer, m_latch_buffer.size);
+	m_latched_data.clear();
+	m_latch_ready = false;
+	m_device->RegisterLateLatch(this);
+	m_device->MarkSceneChanged();
+}
+
+void Renderer::Vulkan::VulkanUniformBuffer::ClearLateLatch()
+{
+	if (!m_latch_callback) return;
+	m_device->UnregisterLateLatch(this);
+	m_latch_callback = nullptr;
+	VulkanCommon::UnMapBufferMemory(m_device, m_latch_buffer);
+	// Queued frames may still copy out of their region
+	VulkanDevice* device = m_device;
+	VulkanBufferData buffer = m_latch_buffer;
+	m_device->DeferDestroy([device, buffer]() mutable
+	{
+		VulkanCommon::DestroyBuffer(device, buffer);
+	});
+	m_latch_buffer = VulkanBufferData();
+}
+
+void Renderer::Vulkan::VulkanUniformBuffer::LateLatch(VkCommandBuffer command_buffer, unsigned int frame)
+{
+	assert(frame < m_latch_frames && "More frames in flight than late latch regions");
+	BufferLocalAllocation& local = m_local_allocation[m_latch_slot];
+	if (!m_latch_ready)
+	{
+		m_latch_callback(local.dataPtr);
+	}
+	m_latch_ready = false;
+	VkDeviceSize offset = (VkDeviceSize)local.bufferSize * frame;
+	memcpy(
+		((char*)m_latch_buffer.mapped_memory) + offset,
+		local.dataPtr,
+		(::size_t)local.bufferSize
+	);
+	m_latched_data.assign((char*)local.dataPtr, ((char*)local.dataPtr) + local.bufferSize);
+	VkBufferCopy region = {};
+	region.srcOffset = offset;
+	region.dstOffset = 0;
+	region.size = local.bufferSize;
+	vkCmdCopyBuffer(
+		command_buffer,
+		m_latch_buffer.buffer,
+		m_gpu_allocation[m_latch_slot].buffer.buffer,
+		1,
+		&region
+	);
+}
+
+bool Renderer::Vulkan::VulkanUniformBuffer::HasLateLatchChanged()
+{
+	BufferLocalAllocation& local = m_local_allocation[m_latch_slot];
+	m_latch_callback(local.dataPtr);
+	bool changed = m_latched_data.size() != local.bufferSize ||
+		memcmp(m_latched_data.data(), local.dataPtr, (::size_t)local.bufferSize) != 0;
+	// Only a change draws a frame this Update, an unchanged result would be stale by the time something else does
+	m_latch_ready = changed;
+	return changed;
+}
@@ -0,0 +1,530 @@
+#include <renderer/vulkan/VulkanUploadBatch.hpp>
+#include <renderer/vulkan/VulkanDevice.hpp>
+#include <renderer/vulkan/VulkanPhysicalDevice.hpp>
+#include <renderer/vulkan/VulkanStagingRing.hpp>
+#include <renderer/vulkan/VulkanCommon.hpp>
+#include <renderer/vulkan/VulkanInitializers.hpp>
+
+#include <assert.h>
+#include <cstring>
+
+Renderer::Vulkan::VulkanUploadBatch::VulkanUploadBatch(VulkanDevice * device)
+{
+	m_device = device;
+	m_dedicated_transfer = m_device->HasDedicatedTransferQueue();
+}
+
+Renderer::Vulkan::VulkanUploadBatch::~VulkanUploadBatch()
+{
+	if (m_submitted)
+	{
+		Wait();
+	}
+	if (m_release_command_buffer != VK_NULL_HANDLE)
+	{
+		m_device->FreeGraphicsCommand(&m_release_command_buffer, 1);
+	}
+	if (m_transfer_command_buffer != VK_NULL_HANDLE)
+	{
+		m_device->FreeTransferCommand(&m_transfer_command_buffer, 1);
+	}
+	if (m_graphics_command_buffer != VK_NULL_HANDLE)
+	{
+		m_device->FreeGraphicsCommand(&m_graphics_command_buffer, 1);
+	}
+	for (auto semaphore : m_semaphores)
+	{
+		vkDestroySemaphore(
+			*m_device->GetVulkanDevice(),
+			semaphore,
+			m_device->GetAllocationCallbacks()
+		);
+	}
+	for (auto region : m_ring_regions)
+	{
+		m_device->GetStagingRing()->Release(region);
+	}
+	for (auto& buffer : m_overflow_buffers)
+	{
+		VulkanCommon::UnMapBufferMemory(m_device, buffer);
+		VulkanCommon::DestroyBuffer(m_device, buffer);
+	}
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::Upload(VkBuffer to_buffer, VkDeviceSize to_offset, const void * data, VkDeviceSize size, bool* graphics_owned)
+{
+	if (size == 0) return;
+	VkDeviceSize offset = 0;
+	VkBuffer staging_buffer = Stage(data, size, offset);
+	AcquireBuffer(to_buffer, graphics_owned);
+	VkBufferCopy copy_region = {};
+	copy_region.srcOffset = offset;
+	copy_region.dstOffset = to_offset;
+	copy_region.size = size;
+	vkCmdCopyBuffer(
+		GetTransferCommandBuffer(),
+		staging_buffer,
+		to_buffer,
+		1,
+		&copy_region
+	);
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::UploadImage(VkImage image, const void * data, VkDeviceSize size, std::vector<VkBufferImageCopy> regions, VkImageSubresourceRange subresource_range, VkImageLayout final_layout, bool* graphics_owned)
+{
+	VkDeviceSize offset = 0;
+	VkBuffer staging_buffer = Stage(data, size, offset);
+	for (auto& region : regions)
+	{
+		region.bufferOffset += offset;
+	}
+	uint32_t graphics_family = m_device->GetVulkanPhysicalDevice()->GetQueueFamilies()->graphics_indices;
+	uint32_t transfer_family = m_device->GetVulkanPhysicalDevice()->GetQueueFamilies()->transfer_indices;
+	VkCommandBuffer command_buffer = GetTransferCommandBuffer();
+
+	// The old contents are thrown away, but the graphics queue may still be sampling them
+	if (m_dedicated_transfer && graphics_owned != nullptr && *graphics_owned)
+	{
+		m_wait_for_graphics = true;
+	}
+
+	VkImageMemoryBarrier barrier = VulkanInitializers::ImageMemoryBarrier();
+	barrier.image = image;
+	barrier.subresourceRange = subresource_range;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		1, &barrier
+	);
+
+	vkCmdCopyBufferToImage(
+		command_buffer,
+		staging_buffer,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()),
+		regions.data()
+	);
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = final_layout;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	if (m_dedicated_transfer)
+	{
+		// Release the image to the graphics family, the layout change happens as part of the hand over
+		barrier.srcQueueFamilyIndex = transfer_family;
+		barrier.dstQueueFamilyIndex = graphics_family;
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier
+		);
+		// Matching acquire on the graphics queue
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			GetGraphicsCommandBuffer(),
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier
+		);
+	}
+	else
+	{
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier
+		);
+	}
+	if (graphics_owned != nullptr) *graphics_owned = true;
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::CopyBuffer(VkBuffer from_buffer, VkBuffer to_buffer, VkDeviceSize size, VkDeviceSize from_offset, VkDeviceSize to_offset)
+{
+	VkCommandBuffer command_buffer = GetGraphicsCommandBuffer();
+	// The source may have been written by an earlier copy in this batch
+	VkMemoryBarrier barrier = VulkanInitializers::MemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		1, &barrier,
+		0, nullptr,
+		0, nullptr
+	);
+	VkBufferCopy copy_region = {};
+	copy_region.srcOffset = from_offset;
+	copy_region.dstOffset = to_offset;
+	copy_region.size = size;
+	vkCmdCopyBuffer(
+		command_buffer,
+		from_buffer,
+		to_buffer,
+		1,
+		&copy_region
+	);
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::CopyBufferToImage(VkBuffer from_buffer, VkImage image, std::vector<VkBufferImageCopy>& regions)
+{
+	vkCmdCopyBufferToImage(
+		GetGraphicsCommandBuffer(),
+		from_buffer,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()),
+		regions.data()
+	);
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
+{
+	VkImageMemoryBarrier barrier = VulkanInitializers::ImageMemoryBarrier(image, format, old_layout, new_layout);
+	vkCmdPipelineBarrier(
+		GetGraphicsCommandBuffer(),
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		0,
+		0,
+		nullptr,
+		0,
+		nullptr,
+		1,
+		&barrier
+	);
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::SetImageLayout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, VkImageSubresourceRange subresource_range)
+{
+	VulkanCommon::SetImageLayout(
+		GetGraphicsCommandBuffer(),
+		image,
+		old_layout,
+		new_layout,
+		subresource_range
+	);
+}
+
+bool Renderer::Vulkan::VulkanUploadBatch::HasCommands()
+{
+	return m_release_command_buffer != VK_NULL_HANDLE ||
+		m_transfer_command_buffer != VK_NULL_HANDLE ||
+		m_graphics_command_buffer != VK_NULL_HANDLE;
+}
+
+Renderer::UploadHandle Renderer::Vulkan::VulkanUploadBatch::GetHandle()
+{
+	return m_handle;
+}
+
+Renderer::Vulkan::VulkanTimelinePoint Renderer::Vulkan::VulkanUploadBatch::GetPoint()
+{
+	return m_point;
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::Submit(UploadHandle handle)
+{
+	assert(!m_submitted && "Upload batch has already been submitted");
+
+	// Make everything this batch wrote visible to the work that is submitted after it
+	VkMemoryBarrier barrier = VulkanInitializers::MemoryBarrier(VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+
+	if (!m_dedicated_transfer)
+	{
+		VkCommandBuffer command_buffer = GetTransferCommandBuffer();
+		vkCmdPipelineBarrier(
+			command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr
+		);
+		ErrorCheck(vkEndCommandBuffer(command_buffer));
+		assert(!HasError() && "Unable to end upload command buffer");
+
+		VulkanSubmission submission;
+		submission.command_buffers.push_back(command_buffer);
+		m_point = m_device->GetGraphicsTimeline()->Submit(submission);
+		m_submitted = true;
+		m_handle = handle;
+		return;
+	}
+
+	uint32_t graphics_family = m_device->GetVulkanPhysicalDevice()->GetQueueFamilies()->graphics_indices;
+	uint32_t transfer_family = m_device->GetVulkanPhysicalDevice()->GetQueueFamilies()->transfer_indices;
+	VkPipelineStageFlags transfer_wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	VkPipelineStageFlags graphics_wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	VkSemaphore transfer_semaphore = VK_NULL_HANDLE;
+
+	if (m_transfer_command_buffer != VK_NULL_HANDLE)
+	{
+		// Hand every buffer we wrote back to the graphics family
+		for (auto buffer : m_transfer_buffers)
+		{
+			VkBufferMemoryBarrier release = VulkanInitializers::BufferMemoryBarrier(buffer, 0, VK_WHOLE_SIZE, VK_ACCESS_TRANSFER_WRITE_BIT, 0);
+			release.srcQueueFamilyIndex = transfer_family;
+			release.dstQueueFamilyIndex = graphics_family;
+			vkCmdPipelineBarrier(
+				m_transfer_command_buffer,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				0,
+				0, nullptr,
+				1, &release,
+				0, nullptr
+			);
+		}
+		ErrorCheck(vkEndCommandBuffer(m_transfer_command_buffer));
+		assert(!HasError() && "Unable to end transfer command buffer");
+
+		VkSemaphore release_semaphore = VK_NULL_HANDLE;
+		if (m_release_command_buffer != VK_NULL_HANDLE || m_wait_for_graphics)
+		{
+			// Signalled once the graphics queue has finished everything submitted before this batch
+			release_semaphore = CreateBatchSemaphore();
+			VulkanSubmission release_submission;
+			if (m_release_command_buffer != VK_NULL_HANDLE)
+			{
+				ErrorCheck(vkEndCommandBuffer(m_release_command_buffer));
+				assert(!HasError() && "Unable to end release command buffer");
+				release_submission.command_buffers.push_back(m_release_command_buffer);
+			}
+			release_submission.signal_semaphores.push_back(release_semaphore);
+			m_device->GetGraphicsTimeline()->Submit(release_submission);
+		}
+
+		// The chain across queues is known up front, so binary semaphores link it whether or not timeline semaphores are available
+		transfer_semaphore = CreateBatchSemaphore();
+		VulkanSubmission transfer_submission;
+		transfer_submission.command_buffers.push_back(m_transfer_command_buffer);
+		if (release_semaphore != VK_NULL_HANDLE)
+		{
+			transfer_submission.wait_semaphores.push_back(release_semaphore);
+			transfer_submission.wait_semaphore_stages.push_back(transfer_wait_stage);
+		}
+		transfer_submission.signal_semaphores.push_back(transfer_semaphore);
+		m_device->GetTransferTimeline()->Submit(transfer_submission);
+	}
+
+	// The graphics side acquires the resources and runs any graphics only copies, its point covers the whole batch
+	VulkanSubmission graphics_submission;
+	if (m_graphics_command_buffer != VK_NULL_HANDLE)
+	{
+		vkCmdPipelineBarrier(
+			m_graphics_command_buffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr
+		);
+		ErrorCheck(vkEndCommandBuffer(m_graphics_command_buffer));
+		assert(!HasError() && "Unable to end upload command buffer");
+		graphics_submission.command_buffers.push_back(m_graphics_command_buffer);
+	}
+	if (transfer_semaphore != VK_NULL_HANDLE)
+	{
+		graphics_submission.wait_semaphores.push_back(transfer_semaphore);
+		graphics_submission.wait_semaphore_stages.push_back(graphics_wait_stage);
+	}
+	m_point = m_device->GetGraphicsTimeline()->Submit(graphics_submission);
+	m_submitted = true;
+	m_handle = handle;
+}
+
+bool Renderer::Vulkan::VulkanUploadBatch::IsComplete()
+{
+	if (!m_submitted) return false;
+	return m_point.timeline->IsComplete(m_point.value);
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::Wait()
+{
+	if (!m_submitted) return;
+	m_point.timeline->Wait(m_point.value);
+}
+
+VkCommandBuffer Renderer::Vulkan::VulkanUploadBatch::GetReleaseCommandBuffer()
+{
+	if (m_release_command_buffer == VK_NULL_HANDLE)
+	{
+		m_release_command_buffer = BeginCommandBuffer(false);
+	}
+	return m_release_command_buffer;
+}
+
+VkCommandBuffer Renderer::Vulkan::VulkanUploadBatch::GetTransferCommandBuffer()
+{
+	if (m_transfer_command_buffer == VK_NULL_HANDLE)
+	{
+		m_transfer_command_buffer = BeginCommandBuffer(true);
+	}
+	return m_transfer_command_buffer;
+}
+
+VkCommandBuffer Renderer::Vulkan::VulkanUploadBatch::GetGraphicsCommandBuffer()
+{
+	// Without a dedicated transfer queue everything shares one command buffer on the graphics queue
+	if (!m_dedicated_transfer) return GetTransferCommandBuffer();
+	if (m_graphics_command_buffer == VK_NULL_HANDLE)
+	{
+		m_graphics_command_buffer = BeginCommandBuffer(false);
+	}
+	return m_graphics_command_buffer;
+}
+
+VkCommandBuffer Renderer::Vulkan::VulkanUploadBatch::BeginCommandBuffer(bool transfer)
+{
+	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+	if (transfer)
+	{
+		m_device->GetTransferCommand(&command_buffer, 1);
+	}
+	else
+	{
+		m_device->GetGraphicsCommand(&command_buffer, (uint32_t)1);
+	}
+	VkCommandBufferBeginInfo begin_info = VulkanInitializers::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	vkBeginCommandBuffer(
+		command_buffer,
+		&begin_info
+	);
+	// Wait for earlier reads of anything we are about to overwrite
+	vkCmdPipelineBarrier(
+		command_buffer,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0, nullptr,
+		0, nullptr,
+		0, nullptr
+	);
+	return command_buffer;
+}
+
+VkBuffer Renderer::Vulkan::VulkanUploadBatch::Stage(const void * data, VkDeviceSize size, VkDeviceSize & offset)
+{
+	VulkanStagingRing* ring = m_device->GetStagingRing();
+	uint64_t region = 0;
+	// Wait for older uploads to hand back their ring space
+	while (!ring->Allocate(size, offset, region))
+	{
+		if (m_device->RetireUpload(true)) continue;
+
+		// Nothing left in flight and it still does not fit, so this upload gets its own buffer
+		VulkanBufferData buffer;
+		VulkanCommon::CreateBuffer(
+			m_device,
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer
+		);
+		VulkanCommon::MapBufferMemory(m_device, buffer, size);
+		memcpy(buffer.mapped_memory, data, (::size_t)size);
+		m_overflow_buffers.push_back(buffer);
+		offset = 0;
+		return buffer.buffer;
+	}
+	memcpy(ring->GetMappedMemory(offset), data, (::size_t)size);
+	m_ring_regions.push_back(region);
+	return ring->GetBuffer();
+}
+
+void Renderer::Vulkan::VulkanUploadBatch::AcquireBuffer(VkBuffer buffer, bool * graphics_owned)
+{
+	if (!m_dedicated_transfer || m_transfer_buffers.count(buffer) > 0)
+	{
+		if (graphics_owned != nullptr) *graphics_owned = true;
+		return;
+	}
+	m_transfer_buffers.insert(buffer);
+
+	uint32_t graphics_family = m_device->GetVulkanPhysicalDevice()->GetQueueFamilies()->graphics_indices;
+	uint32_t transfer_family = m_device->GetVulkanPhysicalDevice()->GetQueueFamilies()->transfer_indices;
+
+	// A partial update has to keep the rest of the buffer, so the graphics queue must hand it over first
+	if (graphics_owned != nullptr && *graphics_owned)
+	{
+		VkBufferMemoryBarrier release = VulkanInitializers::BufferMemoryBarrier(buffer, 0, VK_WHOLE_SIZE, VK_ACCESS_MEMORY_WRITE_BIT, 0);
+		release.srcQueueFamilyIndex = graphics_family;
+		release.dstQueueFamilyIndex = transfer_family;
+		vkCmdPipelineBarrier(
+			GetReleaseCommandBuffer(),
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0,
+			0, nullptr,
+			1, &release,
+			0, nullptr
+		);
+		VkBufferMemoryBarrier acquire = release;
+		acquire.srcAccessMask = 0;
+		acquire.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(
+			GetTransferCommandBuffer(),
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0,
+			0, nullptr,
+			1, &acquire,
+			0, nullptr
+		);
+	}
+
+	// Acquire on the graphics queue, the matching release is recorded when the batch is submitted
+	VkBufferMemoryBarrier acquire = VulkanInitializers::BufferMemoryBarrier(buffer, 0, VK_WHOLE_SIZE, 0, VK_ACCESS_MEMORY_READ_BIT);
+	acquire.srcQueueFamilyIndex = transfer_family;
+	acquire.dstQueueFamilyIndex = graphics_family;
+	vkCmdPipelineBarrier(
+		GetGraphicsCommandBuffer(),
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		0, nullptr,
+		1, &acquire,
+		0, nullptr
+	);
+	if (graphics_owned != nullptr) *graphics_owned = true;
+}
+
+VkSemaphore Renderer::Vulkan::VulkanUploadBatch::CreateBatchSemaphore()
+{
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	VkSemaphoreCreateInfo semaphore_info = VulkanInitializers::SemaphoreCreateInfo();
+	ErrorCheck(vkCreateSemaphore(
+		*m_device->GetVulkanDevice(),
+		&semaphore_info,
+		m_device->GetAllocationCallbacks(),
+		&semaphore
+	));
+	assert(!HasError() && "Unable to create upload semaphore");
+	m_semaphores.push_back(semaphore);
+	return semaphore;
+}